@@ -1,8 +1,8 @@
 /*
-*   This sketch will print all feedback and raw data received from HVAC
-*   ***Not recommend to debug with ESP-01***
+*   This sketch will print debug log of the library
 *   To debug your HVAC please uncomment "#define HVAC_DEBUG" in "ToshibaCarrierHvac.h".
-*   for ESP8266 and Arduino Uno please use software serial
+*   Log is kept in RAM and printed only when you call printLog(), so debug doesn't change protocol timing
+*   and also works when HVAC uses hardware serial (read records with readLog() and send them your own way).
 *   for ESP32 changes tx and rx pin to &Serial2
 */
 
@@ -13,10 +13,12 @@ ToshibaCarrierHvac hvac(D5, D6); // Rx, Tx
 void setup() {
     // put your setup code here, to run once:
     Serial.begin(115200);
+    hvac.setLogLevel(HVAC_LOG_TRACE);   // HVAC_LOG_ERROR, HVAC_LOG_WARN, HVAC_LOG_INFO, HVAC_LOG_DEBUG (default) or HVAC_LOG_TRACE (every packet)
     delay(5000);  // delay 5s before handshake start
 }
 
 void loop() {
     // put your main code here, to run repeatedly:
     hvac.handleHvac();
-}
\ No newline at end of file
+    hvac.printLog(&Serial);     // or hvac.dumpLog(&Serial) and decode with extras/HvacLogDecoder
+}
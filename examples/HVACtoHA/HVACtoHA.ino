@@ -28,10 +28,16 @@ ESP8266HTTPUpdateServer httpUpdater;
 
 WiFiClient espClient;
 PubSubClient mqttClient(espClient);
+uint32_t bootId;    // random per boot, state generation starts again at 0 after reboot
 
 void setup() {
     // put your setup code here, to run once:
     Serial.begin(115200);
+    #if defined(ESP32)
+    bootId = esp_random();
+    #else
+    bootId = RANDOM_REG32;
+    #endif
     /************************
     * Setup: WiFiClient
     ************************/
@@ -55,6 +61,9 @@ void setup() {
     #else
     httpUpdater.setup(&httpServer, update_path, update_username, update_password);
     #endif
+    httpServer.on("/status", statusHandler);
+    const char* statusHeaders[] = {"If-None-Match"};
+    httpServer.collectHeaders(statusHeaders, 1);
     httpServer.begin();
     MDNS.addService("http", "tcp", 80);
     Serial.printf("HTTPUpdateServer ready!\n");
@@ -386,6 +395,40 @@ void mqttReconnect() {
     }
 }
 
+/************************
+* HTTP status, ETag is boot id and state generation, unchanged state is answered with 304 without rendering
+************************/
+void statusHandler() {
+    String etag = "\"" + String(bootId, HEX) + "-" + String(hvac.getGeneration()) + "\"";
+    httpServer.sendHeader("ETag", etag);
+    httpServer.sendHeader("Cache-Control", "no-cache");
+    if (httpServer.header("If-None-Match") == etag) {
+        httpServer.send(304);
+        return;
+    }
+    const size_t bufferSize = JSON_OBJECT_SIZE(15);
+    DynamicJsonDocument jsonBuffer(bufferSize);
+    JsonObject root = jsonBuffer.to<JsonObject>();
+    root["connected"] = hvac.isConnected();
+    root["state"] = hvac.getState();
+    root["setpoint"] = hvac.getSetpoint();
+    root["mode"] = hvac.getMode();
+    root["swing"] = hvac.getSwing();
+    root["fan_mode"] = hvac.getFanMode();
+    root["pure"] = hvac.getPure();
+    root["power_select"] = hvac.getPowerSelect();
+    root["operation"] = hvac.getOperation();
+    root["room_temp"] = hvac.getRoomTemperature();
+    root["outside_temp"] = hvac.getOutsideTemperature();
+    root["off_timer"] = hvac.getOffTimer();
+    root["on_timer"] = hvac.getOnTimer();
+    root["cdu_running"] = hvac.isCduRunning();
+
+    char buffer[measureJson(root) + 1];
+    serializeJson(root, buffer, sizeof(buffer));
+    httpServer.send(200, "application/json", buffer);
+}
+
 /************************
 * HA discovery: hvac
 ************************/
@@ -1,6 +1,6 @@
 /*
 *   This sketch show how to use callback to a custom function.
-*   *: You can use only one callback in your sketch.
+*   All callbacks can be used at the same time.
 */
 
 #include <ToshibaCarrierHvac.h>
@@ -12,9 +12,9 @@ void setup() {
     Serial.begin(115200);
 
     // set a callback function
-    hvac.setStatusUpdatedCallback(whenStatusUpdated);             // *callback when any value in status updated and return data struct of status
-    hvac.setSettingsUpdatedCallback(whenSettingsUpdated);         // *same as above but settings
-    hvac.setUpdateCallback(whenUpdateCallback);                   // *callback when any value in both struct updated
+    hvac.setStatusUpdatedCallback(whenStatusUpdated);             // callback when any value in status updated and return data struct of status
+    hvac.setSettingsUpdatedCallback(whenSettingsUpdated);         // same as above but settings
+    hvac.setUpdateCallback(whenUpdateCallback);                   // callback when any value in both struct updated
     hvac.setWhichFunctionUpdatedCallback(whichFunctionUpdated);   // callback when any value in both struct updated and return name of the function that updated
 }
 
@@ -0,0 +1,131 @@
+/*
+*   Cycle count benchmark of the library on ATmega328P (Uno/Nano) under simavr, no hardware needed
+*   The unit is replaced by a scripted byte stream (bench_script.h) through HvacPipeTransport,
+*   the profiler reads Timer1 as cycle counter so every stage is reported in CPU cycles (16 cycles = 1us).
+*   build and run: extras/AvrBenchmark/run.sh (needs arduino-cli with arduino:avr core and simavr)
+*   output: stage cycles (CALL = handleHvac, DECODE = packet decode and processData, SYNC = handshake, queries,
+*   syncUserSettings, writes, storage and history), max stack depth and static RAM, then simavr stops.
+*   Timer0 interrupt (millis) runs during the benchmark like on a real board and is counted in the stage it interrupts.
+*/
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <ToshibaCarrierHvac.h>
+#include "bench_script.h"
+
+#if !defined(HVAC_PROFILE)
+    #error "build with -DHVAC_USE_HW_SERIAL -DHVAC_PROFILE -DHVAC_PROFILE_CLOCK=benchCycles (see run.sh)"
+#endif
+
+#define STACK_CANARY 0xC5
+#define BENCH_BUDGET 4000   // us per handleHvac call, without budget handshake and query all block with delay() and dominate max
+
+extern uint8_t _end;        // end of static RAM, stack grows down to here
+extern uint8_t __stack;     // RAMEND
+
+// paint free RAM before main() so the lowest stack address can be found later
+void benchPaintStack(void) __attribute__((naked, used, section(".init3")));
+void benchPaintStack(void) {
+    uint8_t* p = &_end;
+    while (p <= &__stack) *p++ = STACK_CANARY;
+}
+
+uint16_t benchStackUsed(void) {
+    uint8_t* p = &_end;
+    while ((p <= &__stack) && (*p == STACK_CANARY)) p++;
+    return &__stack - p + 1;
+}
+
+// Timer1 without prescaler counts CPU cycles, overflow extends it to 32 bits
+volatile uint16_t benchOverflows = 0;
+
+ISR(TIMER1_OVF_vect) {
+    benchOverflows++;
+}
+
+uint32_t benchCycles(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t low = TCNT1;
+    uint16_t high = benchOverflows;
+    if ((TIFR1 & _BV(TOV1)) && (low < 0x8000)) high++;    // overflow not handled yet
+    SREG = sreg;
+    return ((uint32_t)high << 16) | low;
+}
+
+// listener with callbacks so CALLBACK stage is measured
+class BenchListener : public HvacListener {
+    public:
+        uint16_t settings = 0;
+        uint16_t status = 0;
+
+        void onSettings(hvacSettings newSettings) { settings++; }
+        void onStatus(hvacStatus newStatus) { status++; }
+};
+
+typedef HvacPipeTransport<64> BenchTransport;
+BenchTransport transport;
+ToshibaCarrierHvacT<BenchListener, BenchTransport> hvac(&transport);
+
+const uint8_t* scriptEntry = BENCH_SCRIPT;
+uint16_t sentBytes = 0;
+bool actionDone = false;
+
+// inject next script frames when their time is reached, sent bytes are only counted
+void runScript(void) {
+    for (;;) {
+        uint16_t time = (pgm_read_byte(scriptEntry) << 8) | pgm_read_byte(scriptEntry + 1);
+        if (!time || (millis() < time)) break;
+        uint8_t length = pgm_read_byte(scriptEntry + 2);
+        uint8_t frame[32];
+        for (uint8_t i=0; i<length; i++) frame[i] = pgm_read_byte(scriptEntry + 3 + i);
+        transport.inject(frame, length);
+        scriptEntry += 3 + length;
+    }
+    uint8_t data[16];
+    size_t count;
+    while ((count = transport.drain(data, sizeof(data))) > 0) sentBytes += count;
+}
+
+void report(void) {
+    Serial.println(F("AVR benchmark (cycles at 16MHz)"));
+    hvac.printProfile(&Serial);
+    Serial.print(F("stack max: "));
+    Serial.println(benchStackUsed());
+    Serial.print(F("static RAM: "));
+    Serial.println((uint16_t)&_end - RAMSTART);
+    Serial.print(F("connected: "));
+    Serial.print(hvac.isConnected());
+    Serial.print(F(" setpoint: "));
+    Serial.print(hvac.getSetpoint());
+    Serial.print(F(" mode: "));
+    Serial.print(hvac.getMode());
+    Serial.print(F(" sent bytes: "));
+    Serial.print(sentBytes);
+    Serial.print(F(" callbacks: "));
+    Serial.println(hvac.listener().settings + hvac.listener().status);
+    Serial.flush();
+}
+
+void setup() {
+    Serial.begin(115200);
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);     // normal mode, no prescaler
+    TCNT1 = 0;
+    TIMSK1 = _BV(TOIE1);
+}
+
+void loop() {
+    runScript();
+    hvac.handleHvac(BENCH_BUDGET);
+    if (!actionDone && (millis() >= BENCH_ACTION_TIME)) {
+        hvac.setSetpoint(22);
+        hvac.setMode("cool");
+        actionDone = true;
+    }
+    if (millis() >= BENCH_END_TIME) {
+        report();
+        cli();
+        sleep_mode();   // simavr quits when sleeping with interrupts off
+    }
+}
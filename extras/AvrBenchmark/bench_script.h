@@ -0,0 +1,38 @@
+/*
+*   Byte stream sent by the simulated unit, frames are injected when millis() reaches their time.
+*   Times follow the library timing (handshake 200ms steps, START_DELAY 10s before query all) so no reply logic is needed,
+*   replies may come in any order because every reply carries its function.
+*   Entry: time(ms, 2 bytes big endian), length, frame. Ends with time 0.
+*/
+
+#ifndef BENCH_SCRIPT_H
+#define BENCH_SCRIPT_H
+
+#define BENCH_ACTION_TIME 16000     // sketch sets setpoint 22 and mode cool
+#define BENCH_END_TIME 20000        // report and stop simulation
+
+const uint8_t BENCH_SCRIPT[] PROGMEM = {
+    1500 >> 8, 1500 & 0xFF, 10, 2, 0, 0, 128, 0, 0, 2, 0, 0, 126,                                   // handshake SYN/ACK
+    2500 >> 8, 2500 & 0xFF, 15, 2, 0, 3, 17, 0, 0, 7, 1, 48, 1, 0, 2, 136, 66, 231,                 // ready
+    13000 >> 8, 13000 & 0xFF, 20, 2, 0, 3, 144, 0, 0, 12, 1, 48, 1, 0, 0, 0, 5, 248, 67, 24, 65, 0, 150, // group: mode, setpoint, fan mode, operation
+    13200 >> 8, 13200 & 0xFF, 17, 2, 0, 3, 144, 0, 0, 9, 1, 48, 1, 0, 0, 0, 2, 128, 48, 128,      // state
+    13400 >> 8, 13400 & 0xFF, 17, 2, 0, 3, 144, 0, 0, 9, 1, 48, 1, 0, 0, 0, 2, 135, 100, 69,      // power select
+    13600 >> 8, 13600 & 0xFF, 17, 2, 0, 3, 144, 0, 0, 9, 1, 48, 1, 0, 0, 0, 2, 144, 66, 94,       // on timer
+    13800 >> 8, 13800 & 0xFF, 17, 2, 0, 3, 144, 0, 0, 9, 1, 48, 1, 0, 0, 0, 2, 148, 66, 90,       // off timer
+    14000 >> 8, 14000 & 0xFF, 17, 2, 0, 3, 144, 0, 0, 9, 1, 48, 1, 0, 0, 0, 2, 163, 65, 76,       // swing
+    14200 >> 8, 14200 & 0xFF, 17, 2, 0, 3, 144, 0, 0, 9, 1, 48, 1, 0, 0, 0, 2, 187, 26, 91,       // room temperature
+    14400 >> 8, 14400 & 0xFF, 17, 2, 0, 3, 144, 0, 0, 9, 1, 48, 1, 0, 0, 0, 2, 190, 127, 243,     // outside temperature
+    14600 >> 8, 14600 & 0xFF, 17, 2, 0, 3, 144, 0, 0, 9, 1, 48, 1, 0, 0, 0, 2, 199, 16, 89,       // pure
+    14800 >> 8, 14800 & 0xFF, 17, 2, 0, 3, 144, 0, 0, 9, 1, 48, 1, 0, 0, 0, 2, 222, 5, 77,        // wifi led 1
+    15000 >> 8, 15000 & 0xFF, 17, 2, 0, 3, 144, 0, 0, 9, 1, 48, 1, 0, 0, 0, 2, 223, 0, 81,        // wifi led 2
+    16800 >> 8, 16800 & 0xFF, 16, 2, 0, 3, 144, 0, 0, 8, 1, 48, 1, 0, 0, 0, 1, 179, 127,          // setpoint changed
+    17000 >> 8, 17000 & 0xFF, 17, 2, 0, 3, 144, 0, 0, 9, 1, 48, 1, 0, 0, 0, 2, 179, 22, 103,      // setpoint
+    17400 >> 8, 17400 & 0xFF, 16, 2, 0, 3, 144, 0, 0, 8, 1, 48, 1, 0, 0, 0, 1, 176, 130,          // mode changed
+    17600 >> 8, 17600 & 0xFF, 17, 2, 0, 3, 144, 0, 0, 9, 1, 48, 1, 0, 0, 0, 2, 176, 66, 62,       // mode
+    18000 >> 8, 18000 & 0xFF, 15, 2, 0, 3, 17, 0, 0, 7, 1, 48, 1, 0, 2, 187, 27, 219,             // remote: room temperature
+    18400 >> 8, 18400 & 0xFF, 15, 2, 0, 3, 17, 0, 0, 7, 1, 48, 1, 0, 2, 179, 23, 231,             // remote: setpoint
+    18800 >> 8, 18800 & 0xFF, 15, 2, 0, 3, 17, 0, 0, 7, 1, 48, 1, 0, 2, 160, 49, 224,             // remote: fan mode
+    0, 0
+};
+
+#endif // BENCH_SCRIPT_H
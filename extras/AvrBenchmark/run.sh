@@ -0,0 +1,19 @@
+#!/bin/sh
+# Build AvrBenchmark for ATmega328P and run it under simavr
+# needs: arduino-cli (core arduino:avr installed), simavr, avr-size
+# usage: extras/AvrBenchmark/run.sh [build directory]
+# HVAC_USE_HW_SERIAL: the transport is HvacPipeTransport, so CustomSoftwareSerial (AVR default) is not needed
+set -e
+
+SKETCH_DIR=$(cd "$(dirname "$0")" && pwd)
+LIBRARY_DIR=$(cd "$SKETCH_DIR/../.." && pwd)
+BUILD_DIR=${1:-"$SKETCH_DIR/build"}
+
+arduino-cli compile --fqbn arduino:avr:uno \
+    --library "$LIBRARY_DIR" \
+    --build-property "build.extra_flags=-DHVAC_USE_HW_SERIAL -DHVAC_PROFILE -DHVAC_PROFILE_CLOCK=benchCycles" \
+    --output-dir "$BUILD_DIR" \
+    "$SKETCH_DIR"
+
+avr-size -C --mcu=atmega328p "$BUILD_DIR/AvrBenchmark.ino.elf"
+simavr -m atmega328p -f 16000000 "$BUILD_DIR/AvrBenchmark.ino.elf"
@@ -0,0 +1,235 @@
+/*
+*   Fleet load test on Linux: thousands of library instances, each talking to its own simulated indoor unit on a virtual clock.
+*   Instances run in slices of SLICE_MS virtual time on a thread pool with work stealing (owner takes newest task,
+*   idle workers steal oldest and sleep while no task is queued), a cloud workload changes setpoint and mode of every instance every CLOUD_PERIOD.
+*   An instance shares nothing with the others, a hidden global or static in the library shows up as a wrong end state.
+*   build and run: extras/FleetSim/run.sh [instances] [threads] [virtual seconds] (g++ with pthread)
+*   output: memory per instance, frames per second (total and per core), virtual time speedup,
+*   then every instance is checked against its unit (connected, same setpoint and mode), exit code 1 on mismatch.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include "Arduino.h"
+#include <ToshibaCarrierHvac.h>
+#include "HostUnit.h"
+
+#define SLICE_MS 2000           // virtual time an instance runs before its task is queued again
+#define CLOUD_PERIOD 30000      // ms between cloud changes of one instance
+#define CLOUD_START 20000       // first change, after handshake and query all
+#define CLOUD_SETTLE 15000      // no change in last ms of the run, so writes are confirmed before the check
+#define HEARTBEAT_INTERVAL 5000 // 0 = off
+
+thread_local uint64_t* hostClock = nullptr;
+
+class FleetListener : public HvacListener {
+    public:
+        uint32_t settings = 0;
+        uint32_t status = 0;
+        uint32_t linkDown = 0;
+
+        void onSettings(hvacSettings newSettings) { settings++; }
+        void onStatus(hvacStatus newStatus) { status++; }
+        void onLink(bool up) { if (!up) linkDown++; }
+};
+
+typedef ToshibaCarrierHvacT<FleetListener, HostUnit> FleetHvac;
+
+const char* const CLOUD_MODES[5] = {"auto", "cool", "heat", "dry", "fan_only"};
+
+struct FleetInstance {
+    uint64_t clock = 0;         // virtual time, us
+    HostUnit unit;
+    FleetHvac hvac;
+    uint32_t random;            // xorshift state of cloud workload
+    uint32_t nextCloud;
+    uint8_t setpoint = 24;      // last value sent by cloud
+    const char* mode = "cool";
+
+    FleetInstance() : hvac(&unit) {}
+};
+
+struct FleetWorker {
+    std::mutex lock;
+    std::deque<uint32_t> tasks;
+    uint64_t frames = 0;
+    uint32_t slices = 0;
+    uint32_t steals = 0;
+};
+
+// idle workers sleep on wake until a task is queued or all instances finished
+struct FleetPool {
+    std::mutex lock;
+    std::condition_variable wake;
+    std::atomic<uint32_t> queued;
+    std::atomic<uint32_t> remaining;
+};
+
+static uint32_t nextRandom(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void cloud(FleetInstance* instance, uint32_t end) {
+    uint32_t now = instance->clock / 1000;
+    if (((int32_t)(now - instance->nextCloud) < 0) || (now + CLOUD_SETTLE > end)) return;
+    instance->nextCloud += CLOUD_PERIOD;
+    if (!instance->hvac.isConnected()) return;
+    instance->setpoint = 17 + (nextRandom(&instance->random) % 14);
+    instance->mode = CLOUD_MODES[nextRandom(&instance->random) % 5];
+    instance->hvac.setSetpoint(instance->setpoint);
+    instance->hvac.setMode(instance->mode);
+}
+
+// run instance until virtual time "until" (us), sleeps to next deadline like a real event loop
+static void runSlice(FleetInstance* instance, uint64_t until, uint32_t end) {
+    hostClock = &instance->clock;
+    uint8_t busy = 0;
+    while (instance->clock < until) {
+        cloud(instance, end);
+        instance->hvac.handleHvac();
+        uint32_t wait = instance->hvac.getNextDeadline();
+        uint32_t arrival = instance->unit.nextArrival();
+        if (arrival < wait) wait = arrival;
+        uint32_t untilCloud = instance->nextCloud - (uint32_t)(instance->clock / 1000);
+        if (untilCloud < wait) wait = untilCloud;
+        if (!wait) {
+            if (++busy < 4) continue;
+            wait = 1;   // due work that does not progress, e.g. write waiting for TX space
+        }
+        busy = 0;
+        uint64_t next = instance->clock + (uint64_t)wait * 1000;
+        instance->clock = (next < until) ? next : until;
+    }
+    hostClock = nullptr;
+}
+
+static bool takeTask(std::vector<FleetWorker>& workers, FleetPool& pool, uint32_t self, uint32_t* task) {
+    {
+        std::lock_guard<std::mutex> guard(workers[self].lock);
+        if (!workers[self].tasks.empty()) {
+            *task = workers[self].tasks.back();
+            workers[self].tasks.pop_back();
+            pool.queued--;
+            return true;
+        }
+    }
+    for (uint32_t i=1; i<workers.size(); i++) {
+        FleetWorker& victim = workers[(self + i) % workers.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (victim.tasks.empty()) continue;
+        *task = victim.tasks.front();
+        victim.tasks.pop_front();
+        pool.queued--;
+        workers[self].steals++;
+        return true;
+    }
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t count = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 2000;
+    uint32_t threads = (argc > 2) ? strtoul(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+    uint32_t seconds = (argc > 3) ? strtoul(argv[3], nullptr, 10) : 300;
+    if (!count || !threads || !seconds) {
+        printf("usage: %s [instances] [threads] [virtual seconds]\n", argv[0]);
+        return 2;
+    }
+    uint32_t end = seconds * 1000;
+
+    uint64_t boot = 0;
+    hostClock = &boot;     // constructor reads the clock, every instance starts at 0
+    FleetInstance* instances = new FleetInstance[count];
+    for (uint32_t i=0; i<count; i++) {
+        hostClock = &instances[i].clock;
+        instances[i].random = 2463534242UL + i;
+        instances[i].nextCloud = CLOUD_START + (i % CLOUD_PERIOD);     // spread cloud load
+        if (HEARTBEAT_INTERVAL) instances[i].hvac.setHeartbeat(HEARTBEAT_INTERVAL);
+    }
+    hostClock = nullptr;
+
+    std::vector<FleetWorker> workers(threads);
+    for (uint32_t i=0; i<count; i++) workers[i % threads].tasks.push_back(i);
+    FleetPool shared;
+    shared.queued = count;
+    shared.remaining = count;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (uint32_t w=0; w<threads; w++) {
+        pool.emplace_back([&, w]() {
+            FleetWorker& self = workers[w];
+            while (shared.remaining.load() > 0) {
+                uint32_t task;
+                if (!takeTask(workers, shared, w, &task)) {
+                    std::unique_lock<std::mutex> idle(shared.lock);
+                    shared.wake.wait(idle, [&]() { return shared.queued.load() || !shared.remaining.load(); });
+                    continue;
+                }
+                FleetInstance* instance = &instances[task];
+                uint32_t frames = instance->unit.frames;
+                uint64_t until = instance->clock + (uint64_t)SLICE_MS * 1000;
+                if (until > (uint64_t)end * 1000) until = (uint64_t)end * 1000;
+                runSlice(instance, until, end);
+                self.frames += instance->unit.frames - frames;
+                self.slices++;
+                if (instance->clock >= (uint64_t)end * 1000) {
+                    std::lock_guard<std::mutex> idle(shared.lock);
+                    if (!--shared.remaining) shared.wake.notify_all();
+                } else {
+                    {
+                        std::lock_guard<std::mutex> guard(self.lock);
+                        self.tasks.push_back(task);
+                    }
+                    std::lock_guard<std::mutex> idle(shared.lock);     // counted under lock, a waiter cannot miss it
+                    shared.queued++;
+                    shared.wake.notify_one();
+                }
+            }
+        });
+    }
+    for (std::thread& t : pool) t.join();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t frames = 0;
+    uint32_t failed = 0;
+    uint64_t callbacks = 0;
+    uint32_t linkDown = 0;
+    for (uint32_t i=0; i<count; i++) {
+        FleetInstance* instance = &instances[i];
+        hostClock = &instance->clock;
+        frames += instance->unit.frames;
+        callbacks += instance->hvac.listener().settings + instance->hvac.listener().status;
+        linkDown += instance->hvac.listener().linkDown;
+        bool ok = instance->hvac.isConnected()
+            && (instance->hvac.getSetpoint() == instance->setpoint)
+            && (instance->unit.get(179) == instance->setpoint)
+            && !strcmp(instance->hvac.getMode(), instance->mode);
+        if (!ok && (failed++ < 10)) {
+            printf("instance %u: connected %d setpoint %u/%u/%u mode %s/%s\n", i, instance->hvac.isConnected(),
+                instance->hvac.getSetpoint(), instance->unit.get(179), instance->setpoint, instance->hvac.getMode(), instance->mode);
+        }
+    }
+    hostClock = nullptr;
+
+    printf("instances: %u threads: %u virtual: %us wall: %.2fs speedup: %.0fx\n", count, threads, seconds, wall,
+        (double)seconds * count / wall);
+    printf("memory per instance: %u bytes (library %u, unit %u)\n", (unsigned)sizeof(FleetInstance),
+        (unsigned)sizeof(FleetHvac), (unsigned)sizeof(HostUnit));
+    printf("frames: %llu, %.0f/s, %.0f/s per core, callbacks: %llu, link down: %u\n", (unsigned long long)frames,
+        frames / wall, frames / wall / threads, (unsigned long long)callbacks, linkDown);
+    for (uint32_t w=0; w<threads; w++) {
+        printf("worker %u: slices %u steals %u frames %.0f/s\n", w, workers[w].slices, workers[w].steals, workers[w].frames / wall);
+    }
+    printf("check: %u of %u instances wrong\n", failed, count);
+    delete[] instances;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,17 @@
+#!/bin/sh
+# Build FleetSim with the host compiler and run it
+# needs: g++ with C++11 and pthread (Linux)
+# usage: extras/FleetSim/run.sh [instances] [threads] [virtual seconds], extra compiler flags in CXXFLAGS (e.g. -fsanitize=thread)
+set -e
+
+SIM_DIR=$(cd "$(dirname "$0")" && pwd)
+LIBRARY_DIR=$(cd "$SIM_DIR/../.." && pwd)
+BUILD_DIR="$SIM_DIR/build"
+
+mkdir -p "$BUILD_DIR"
+g++ -std=gnu++11 -O2 -pthread -DARDUINO=100 $CXXFLAGS \
+    -I"$LIBRARY_DIR/extras/HostTests" -I"$LIBRARY_DIR/src" \
+    -o "$BUILD_DIR/fleet_sim" \
+    "$SIM_DIR/FleetSim.cpp" "$LIBRARY_DIR"/src/*.cpp
+
+"$BUILD_DIR/fleet_sim" "$@"
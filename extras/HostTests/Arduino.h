@@ -0,0 +1,85 @@
+/*
+*   Minimal Arduino core to build the library on Linux, only what the library uses. Shared by HostTests, FleetSim and LinuxGateway.
+*   Time is virtual: millis(), micros() and delay() use the clock hostClock points to (thread local, so each thread can
+*   run instances on its own clock), every read of the clock costs HOST_CALL_US so busy waits of the library end.
+*   With HOST_REAL_CLOCK (LinuxGateway) millis() and micros() read CLOCK_MONOTONIC and delay() sleeps.
+*   There is no global Serial, an instance can only reach the transport it was given.
+*/
+
+#ifndef HostTests_Arduino_H
+#define HostTests_Arduino_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <time.h>
+
+#define HOST_CALL_US 1     // virtual time of one millis()/micros() call
+
+typedef uint8_t byte;
+
+#define F(text) text
+#define SERIAL_8E1 0x2E
+
+#if defined(HOST_REAL_CLOCK)
+inline uint64_t hostMicros(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+inline uint32_t micros(void) { return (uint32_t)hostMicros(); }
+inline uint32_t millis(void) { return (uint32_t)(hostMicros() / 1000); }
+
+inline void delay(unsigned long ms) {
+    struct timespec wait = {(time_t)(ms / 1000), (long)(ms % 1000) * 1000000};
+    while (nanosleep(&wait, &wait) < 0) {}    // interrupted, sleep rest
+}
+#else
+extern thread_local uint64_t* hostClock;  // virtual time (us) of this thread
+
+inline uint32_t micros(void) { *hostClock += HOST_CALL_US; return (uint32_t)*hostClock; }
+inline uint32_t millis(void) { *hostClock += HOST_CALL_US; return (uint32_t)(*hostClock / 1000); }
+inline void delay(unsigned long ms) { *hostClock += (uint64_t)ms * 1000; }
+#endif
+inline void yield(void) {}
+
+// text goes to stdout
+class Print {
+    public:
+        virtual size_t write(uint8_t c) { return fwrite(&c, 1, 1, stdout); }
+        virtual size_t write(const uint8_t* data, size_t length) { return fwrite(data, 1, length, stdout); }
+        virtual int availableForWrite(void) { return 0; }
+        size_t print(const char* text) { return printf("%s", text); }
+        size_t print(long value) { return printf("%ld", value); }
+        size_t print(unsigned long value) { return printf("%lu", value); }
+        size_t print(int value) { return printf("%d", value); }
+        size_t print(unsigned int value) { return printf("%u", value); }
+        size_t println(const char* text = "") { return printf("%s\n", text); }
+        size_t println(long value) { return printf("%ld\n", value); }
+        size_t println(unsigned long value) { return printf("%lu\n", value); }
+        size_t println(int value) { return printf("%d\n", value); }
+        size_t println(unsigned int value) { return printf("%u\n", value); }
+        virtual ~Print() {}
+};
+
+class Stream : public Print {
+    public:
+        virtual int available(void) { return 0; }
+        virtual int read(void) { return -1; }
+        virtual size_t readBytes(uint8_t* data, size_t length) {
+            size_t count = 0;
+            while ((count < length) && (available() > 0)) data[count++] = read();
+            return count;
+        }
+};
+
+class HardwareSerial : public Stream {
+    public:
+        void begin(unsigned long baud, int config = SERIAL_8E1) {}
+        using Print::write;
+};
+
+#endif // HostTests_Arduino_H
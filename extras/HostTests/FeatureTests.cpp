@@ -0,0 +1,49 @@
+/*
+*   Host test of a reduced build, run.sh builds it with HVAC_FEATURES 0 (only state, setpoint, mode, fan mode and temperatures).
+*   build and run: extras/HostTests/run.sh features
+*/
+
+#include "HostTest.h"
+
+#if HVAC_FEATURES != 0
+    #error "Build with -DHVAC_FEATURES=0"
+#endif
+
+// removed functions are not queried and not decoded (stay nullptr), functions always in still work
+static void testFeatures(void) {
+    TestRig<> rig;
+    rig.port.record = true;
+    rig.run(CONNECT_TIME);
+    rig.port.record = false;
+    CHECK(rig.hvac.isConnected());
+    const uint8_t removed[7] = {163, 199, 135, 247, 222, 148, 144};     // swing, pure, power select, operation, wifi led, timers
+    for (uint8_t i=0; i<sizeof(removed); i++) CHECK_EQUAL(countQueries(&rig.port, removed[i]), 0);
+    CHECK_EQUAL(countQueries(&rig.port, 248), 1);
+
+    hvacSettings settings = rig.hvac.getSettings();
+    CHECK(settings.swing == nullptr);
+    CHECK(settings.pure == nullptr);
+    CHECK(settings.powerSelect == nullptr);
+    CHECK(settings.operation == nullptr);     // carried by group reply
+    CHECK(settings.wifiLed == nullptr);
+    hvacStatus status = rig.hvac.getStatus();
+    CHECK(status.offTimer == nullptr);
+    CHECK(status.onTimer == nullptr);
+    CHECK(!strcmp(settings.mode, "cool"));
+    CHECK_EQUAL(settings.setpoint, 24);
+    CHECK_EQUAL(status.roomTemperature, 26);
+
+    rig.hvac.setMode("heat");
+    rig.run(3000);
+    CHECK(!strcmp(rig.hvac.getMode(), "heat"));
+    CHECK(rig.port.unit.get(176) != 66);
+    CHECK_EQUAL(rig.hvac.getHistoryLength(HISTORY_FINE), 0);    // history is opt-in
+}
+
+static const HostTest TESTS[1] = {
+    {"features", testFeatures}
+};
+
+int main(int argc, char* argv[]) {
+    return runTests(TESTS, sizeof(TESTS) / sizeof(TESTS[0]), argc, argv);
+}
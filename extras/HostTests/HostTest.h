@@ -0,0 +1,147 @@
+/*
+*   Test rig shared by the host test programs: virtual clock, checks, port with knobs in front of HostUnit and runner.
+*   Include once per program, after it only tests and their table.
+*/
+
+#ifndef HostTest_H
+#define HostTest_H
+
+#include <stdlib.h>
+#include "Arduino.h"
+#include <ToshibaCarrierHvac.h>
+#include "HostUnit.h"
+
+#define CONNECT_TIME 20000      // ms to handshake and query all before a test starts
+
+thread_local uint64_t* hostClock = nullptr;
+static uint64_t testClock = 0;
+static uint32_t checks = 0;
+static uint32_t failed = 0;
+
+#define CHECK(condition) do { \
+        checks++; \
+        if (!(condition)) { \
+            failed++; \
+            printf("  %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+        } \
+    } while (0)
+
+#define CHECK_EQUAL(value, expected) do { \
+        checks++; \
+        long long actual = (long long)(value); \
+        if (actual != (long long)(expected)) { \
+            failed++; \
+            printf("  %s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #value, actual, (long long)(expected)); \
+        } \
+    } while (0)
+
+// HostUnit behind the serial port of the library, with knobs: answers of a muted unit are lost on the line,
+// limited TX space of the library side and a copy of every byte written
+class TestPort : public HardwareSerial {
+    public:
+        HostUnit unit;
+        bool mute = false;
+        int space = 64;         // bytes the library can write without waiting
+        bool record = false;
+        uint8_t written[512];
+        size_t writtenLength = 0;
+
+        int available(void) {
+            if (mute) {     // drop what the unit sent
+                uint8_t lost[32];
+                while (unit.readBytes(lost, sizeof(lost))) {}
+                return 0;
+            }
+            return unit.available();
+        }
+
+        int read(void) {
+            uint8_t c;
+            return unit.readBytes(&c, 1) ? c : -1;
+        }
+
+        size_t readBytes(uint8_t data[], size_t length) { return unit.readBytes(data, length); }
+        size_t write(uint8_t c) { return write(&c, 1); }
+
+        size_t write(const uint8_t data[], size_t length) {
+            if (length > (size_t)space) length = space;
+            for (size_t i=0; record && (i<length) && (writtenLength < sizeof(written)); i++) written[writtenLength++] = data[i];
+            return unit.write(data, length);
+        }
+
+        int availableForWrite(void) { return space; }
+};
+
+// port and instance, port is constructed first
+template <class Hvac = ToshibaCarrierHvac>
+struct TestRig {
+    TestPort port;
+    Hvac hvac;
+    uint32_t budget = 0;        // time budget of handleHvac(us)
+    uint64_t longest = 0;       // longest handleHvac call(us)
+    uint32_t calls = 0;         // handleHvac calls
+
+    TestRig() : hvac(&port) {}
+
+    // run for ms of virtual time, sleeps to next deadline or unit reply like a real event loop
+    void run(uint32_t ms) {
+        uint64_t until = testClock + (uint64_t)ms * 1000;
+        uint8_t busy = 0;
+        while (testClock < until) {
+            uint64_t start = testClock;
+            hvac.handleHvac(budget);
+            calls++;
+            if ((testClock - start) > longest) longest = testClock - start;
+            uint32_t wait = hvac.getNextDeadline();
+            uint32_t arrival = port.unit.nextArrival();
+            if (arrival < wait) wait = arrival;
+            if (!wait) {
+                if (++busy < 4) continue;
+                wait = 1;   // due work that does not progress, e.g. packet waiting for TX space
+            }
+            busy = 0;
+            uint64_t next = testClock + (uint64_t)wait * 1000;
+            testClock = (next < until) ? next : until;
+        }
+    }
+};
+
+// query frames in bytes written by the library, of one function or of any function (0), first queried function to first
+static uint8_t countQueries(const TestPort* port, uint8_t function, uint8_t* first = nullptr) {
+    uint8_t count = 0;
+    for (size_t i=0; (i + 14) <= port->writtenLength; i++) {
+        const uint8_t* frame = &port->written[i];
+        if ((frame[0] != 2) || (frame[3] != 16) || (frame[6] != 6) || (frame[11] != 1)) continue;
+        if (first && !*first) *first = frame[12];
+        if (!function || (frame[12] == function)) count++;
+    }
+    return count;
+}
+
+struct HostTest {
+    const char* name;
+    void (*function)(void);
+};
+
+// run all tests or the one named by argv[1], exit code 1 when a check failed, 2 when no test was run
+static int runTests(const HostTest tests[], uint8_t count, int argc, char* argv[]) {
+    hostClock = &testClock;
+    uint8_t run = 0;
+    for (uint8_t i=0; i<count; i++) {
+        if ((argc > 1) && strcmp(argv[1], tests[i].name)) continue;
+        uint32_t before = failed;
+        printf("%s\n", tests[i].name);
+        testClock = 0;
+        tests[i].function();
+        if (failed != before) printf("  %u failed\n", failed - before);
+        run++;
+    }
+    if (!run) {
+        printf("usage: %s [test name]\n", argv[0]);
+        return 2;
+    }
+    printf("tests: %u checks: %u failed: %u\n", run, checks, failed);
+    return failed ? 1 : 0;
+}
+
+#endif // HostTest_H
@@ -0,0 +1,654 @@
+/*
+*   Host tests of the library on Linux, one test per feature. The library runs against HostUnit (simulated unit)
+*   on a virtual clock, time only moves when a test runs it.
+*   build and run: extras/HostTests/run.sh [test name] (g++ with C++11), prints failed checks, exit code 1 on failure.
+*/
+
+#include "HostTest.h"
+
+// storage in RAM, kept when a new instance is created (reboot)
+class TestStorage : public HvacStorage {
+    public:
+        uint8_t data[256] {};
+        uint32_t writes = 0;
+
+        bool read(uint16_t address, uint8_t buffer[], uint16_t length) {
+            if ((uint32_t)address + length > sizeof(data)) return false;
+            memcpy(buffer, &data[address], length);
+            return true;
+        }
+
+        bool write(uint16_t address, const uint8_t buffer[], uint16_t length) {
+            if ((uint32_t)address + length > sizeof(data)) return false;
+            memcpy(&data[address], buffer, length);
+            writes++;
+            return true;
+        }
+};
+
+// poll interval is updated when the last temperature reply of a poll is parsed, not when pipelined queries are queued
+static void testPoll(void) {
+    TestRig<> rig;
+    rig.hvac.setQueryPipeline(2);
+    rig.run(CONNECT_TIME);
+    rig.hvac.setPollInterval(10, 80);
+    rig.run(25000);     // polls answered with the same temperatures
+    uint16_t interval = rig.hvac.getPollInterval();
+    CHECK(interval > 10);
+    rig.port.unit.set(187, 28);     // room temperature changed, the next poll goes back to min
+    rig.run(interval * 1000UL + 500);
+    CHECK_EQUAL(rig.hvac.getRoomTemperature(), 28);
+    CHECK_EQUAL(rig.hvac.getPollInterval(), 10);
+    rig.run(10500);     // stable again
+    CHECK_EQUAL(rig.hvac.getPollInterval(), 20);
+}
+
+// calibration waits for outstanding queries, replies count only for the function sent, current setpoint is written 4 times
+static void testCalibrate(void) {
+    TestRig<> rig;
+    rig.hvac.setQueryPipeline(MAX_QUERY_PIPELINE);
+    rig.run(CONNECT_TIME);
+    CHECK(rig.hvac.probeFunctions());
+    rig.run(10);    // pipelined queries outstanding
+    rig.port.record = true;
+    uint64_t start = testClock;
+    CHECK(rig.hvac.calibratePacing());
+    CHECK((testClock - start) < 8000000);
+    rig.port.record = false;
+    uint8_t writes = 0;
+    for (size_t i=0; (i + 15) <= rig.port.writtenLength; i++) {
+        const uint8_t* frame = &rig.port.written[i];
+        if ((frame[0] == 2) && (frame[3] == 16) && (frame[6] == 7) && (frame[11] == 2) && (frame[12] == 179)) writes++;
+    }
+    CHECK_EQUAL(writes, 4);
+    CHECK_EQUAL(rig.port.unit.get(179), 24);
+    hvacPacing pacing = rig.hvac.getPacing();
+    CHECK(pacing.latency >= UNIT_LATENCY);
+    CHECK(pacing.queryGap < 200);       // defaults
+    CHECK(pacing.settingsGap < 600);
+    CHECK(pacing.settingsGap >= pacing.latency);
+    HvacWrite write = rig.hvac.setSetpoint(22);
+    rig.run(5000);      // queries not answered before calibration are sent again
+    CHECK(write.isDone());
+    CHECK(!rig.hvac.isProbing());
+    CHECK(rig.hvac.isFieldSupported(FIELD_SWING));    // probe queries outstanding during calibration were answered
+    CHECK(rig.hvac.isFieldSupported(FIELD_PSEL));
+}
+
+// changed settings are cached, after reboot cached state is there at once and revalidated without query all
+static void testWarmStart(void) {
+    TestStorage storage;
+    {
+        TestRig<> rig;
+        CHECK(!rig.hvac.setStorage(&storage, 16));     // empty storage
+        rig.run(CONNECT_TIME);
+        rig.hvac.setSetpoint(21);
+        rig.run(65000);     // one cache check after setting changed
+        CHECK_EQUAL(rig.port.unit.get(179), 21);
+        CHECK_EQUAL(storage.writes, 1);
+        rig.run(65000);     // nothing changed, nothing written
+        CHECK_EQUAL(storage.writes, 1);
+    }
+
+    testClock = 0;  // reboot, new unit has 24 like a unit changed by remote meanwhile
+    TestRig<> rig;
+    CHECK(rig.hvac.setStorage(&storage, 16));
+    CHECK_EQUAL(rig.hvac.getSetpoint(), 21);
+    CHECK(!strcmp(rig.hvac.getState(), "on"));
+    CHECK(!rig.hvac.isRevalidated());
+    rig.run(5000);      // handshake and one query per function, no start delay
+    CHECK(rig.hvac.isRevalidated());
+    CHECK_EQUAL(rig.hvac.getSetpoint(), 24);
+}
+
+// handle of a setter is done when the unit reports the value, superseded by a newer write, timed out without answer
+static void testWrites(void) {
+    TestRig<> rig;
+    rig.run(CONNECT_TIME);
+    HvacWrite write = rig.hvac.setSetpoint(22);
+    CHECK(write.isPending());
+    rig.run(3000);
+    CHECK(write.isDone());
+    CHECK(write.latency() >= UNIT_LATENCY);
+    CHECK_EQUAL(rig.port.unit.get(179), 22);
+
+    HvacWrite older = rig.hvac.setSetpoint(25);
+    HvacWrite newer = rig.hvac.setSetpoint(26);
+    CHECK_EQUAL(older.state(), WRITE_SUPERSEDED);
+    rig.run(3000);
+    CHECK(newer.isDone());
+    CHECK_EQUAL(rig.port.unit.get(179), 26);
+
+    HvacWrite same = rig.hvac.setSetpoint(26);     // value the unit has, done after the unit reported it again
+    CHECK(same.isPending());
+    rig.run(3000);
+    CHECK(same.isDone());
+
+    write = rig.hvac.setMode("dry_heat");      // invalid, nothing is sent
+    CHECK_EQUAL(write.state(), WRITE_REJECTED);
+    rig.run(3000);
+    CHECK(!strcmp(rig.hvac.getMode(), "cool"));
+    CHECK_EQUAL(rig.port.unit.get(176), 66);
+
+    rig.hvac.setCoalesceDelay(60000);   // timeout longer than 65.5 s
+    write = rig.hvac.setSetpoint(23);
+    rig.run(30000);
+    CHECK(write.isPending());
+    rig.run(40000);
+    CHECK(write.isDone());
+    CHECK(write.latency() >= 60000);
+    rig.hvac.setCoalesceDelay(0);
+
+    rig.port.mute = true;
+    same = rig.hvac.setSetpoint(23);    // no reply, nothing confirms it
+    write = rig.hvac.setMode("heat");
+    rig.run(9000);      // 10s plus one settings delay
+    CHECK(write.isPending());
+    rig.run(2000);
+    CHECK_EQUAL(write.state(), WRITE_TIMEOUT);
+    CHECK_EQUAL(same.state(), WRITE_TIMEOUT);
+    CHECK(write.isFailed());
+    CHECK_EQUAL(write.latency(), 0);
+    CHECK(!HvacWrite().isPending());
+}
+
+// each consumer reads new events at its own pace, a consumer that fell behind counts overwritten events
+static void testEvents(void) {
+    TestRig<> rig;
+    rig.run(CONNECT_TIME);
+    HvacEventCursor all = rig.hvac.getEventCursor(true);
+    hvacEvent event;
+    uint8_t count = 0;
+    while (rig.hvac.readEvent(&all, &event)) count++;
+    CHECK(count > 0);   // query all decoded
+    CHECK_EQUAL(all.missed, 0);
+
+    HvacEventCursor fast = rig.hvac.getEventCursor();
+    HvacEventCursor slow = rig.hvac.getEventCursor();
+    CHECK(!rig.hvac.readEvent(&fast, &event));
+    rig.hvac.setSetpoint(22);
+    rig.run(3000);
+    CHECK(rig.hvac.readEvent(&fast, &event));
+    CHECK_EQUAL(event.field, FIELD_SETPOINT);
+    CHECK_EQUAL(event.oldValue, 24);
+    CHECK_EQUAL(event.newValue, 22);
+    CHECK(event.time >= CONNECT_TIME);
+    CHECK(!strcmp(rig.hvac.getFieldName(event.field), "SETPOINT"));
+    CHECK(!rig.hvac.readEvent(&fast, &event));
+
+    for (uint8_t i=0; i<=EVENT_BUFFER_SIZE; i++) {    // 2 events more than buffer since slow cursor was taken
+        rig.hvac.setSetpoint((i % 2) ? 22 : 21);
+        rig.run(4000);
+    }
+    count = 0;
+    while (rig.hvac.readEvent(&slow, &event)) count++;
+    CHECK_EQUAL(count, EVENT_BUFFER_SIZE);
+    CHECK_EQUAL(slow.missed, 2);
+    CHECK_EQUAL(event.newValue, 21);
+    count = 0;
+    while (rig.hvac.readEvent(&fast, &event)) count++;
+    CHECK_EQUAL(count, EVENT_BUFFER_SIZE);
+    CHECK_EQUAL(fast.missed, 1);
+}
+
+// packets are queued whole while transport is full and leave the ring in order when it wraps
+static void testTxRing(void) {
+    TestRig<> rig;
+    rig.run(CONNECT_TIME);
+    CHECK(rig.hvac.isConnected());
+
+    const uint8_t functions[8] = {128, 135, 144, 148, 160, 163, 187, 190};
+    byte packets[8][14];
+    for (uint8_t i=0; i<8; i++) {
+        const byte query[14] = HVAC_QUERY_PACKET(functions[i]);
+        memcpy(packets[i], query, sizeof(query));
+    }
+    rig.port.space = 0;
+    rig.port.record = true;
+    for (uint8_t i=0; i<4; i++) CHECK(rig.hvac.sendCustomPacket(packets[i], 14));
+    CHECK(!rig.hvac.sendCustomPacket(packets[4], 14));     // 56 of 64 bytes used, never part of a packet
+    rig.port.space = 5;     // 5 bytes per write, ring wraps in the middle of a packet
+    rig.run(100);
+    for (uint8_t i=4; i<8; i++) CHECK(rig.hvac.sendCustomPacket(packets[i], 14));
+    rig.run(500);
+    rig.port.record = false;
+
+    CHECK_EQUAL(rig.port.writtenLength, 8 * 14);
+    CHECK(!memcmp(rig.port.written, packets, 8 * 14));
+}
+
+static void testLog(void) {
+    hvacLogRecord record {0xA1B2C3D4, HVAC_EV_SETPOINT_RANGE, {35, 30, -32768}};
+    uint8_t data[HVAC_LOG_RECORD_SIZE];
+    CHECK_EQUAL(hvacPackLogRecord(&record, data), HVAC_LOG_RECORD_SIZE);
+    CHECK_EQUAL(data[0], 0xD4);     // little endian
+    CHECK_EQUAL(data[3], 0xA1);
+    hvacLogRecord unpacked;
+    hvacUnpackLogRecord(data, &unpacked);
+    CHECK_EQUAL(unpacked.time, record.time);
+    CHECK_EQUAL(unpacked.event, record.event);
+    CHECK_EQUAL(unpacked.arg[0], 35);
+    CHECK_EQUAL(unpacked.arg[2], -32768);
+
+    const char* const fields[2] = {"STATE", "SETPOINT"};
+    char text[80];
+    hvacFormatLogRecord(text, sizeof(text), &record, fields, 2);
+    CHECK(!strcmp(text, "User wanted setpoint 35 out of range, set to 30"));
+
+    record = hvacLogRecord {0, HVAC_EV_USER_SETTING, {1, -17, 0}};
+    hvacFormatLogRecord(text, sizeof(text), &record, fields, 2);
+    CHECK(!strcmp(text, "User wanted SETPOINT-> -17"));
+    record.arg[0] = 7;      // field out of range is printed as number
+    hvacFormatLogRecord(text, sizeof(text), &record, fields, 2);
+    CHECK(!strcmp(text, "User wanted 7-> -17"));
+
+    CHECK_EQUAL(hvacFormatLogRecord(text, 8, &record, fields, 2), 7);      // cut to buffer
+    CHECK(!strcmp(text, "User wa"));
+
+    record.event = HVAC_EV_COUNT;
+    hvacFormatLogRecord(text, sizeof(text), &record, fields, 2);
+    CHECK(!strcmp(text, "Unknown event"));
+    CHECK_EQUAL(hvacLogLevelOf(HVAC_EV_COUNT), HVAC_LOG_ERROR);
+}
+
+static void testHistory(void) {
+    HvacHistoryLevel<3> history(1);
+    hvacHistoryBucket bucket {};
+    CHECK(!history.get(0, &bucket));
+
+    for (uint8_t i=0; i<60; i++) history.sample(true, 20 + (i % 2), (i % 2) ? -3 : -4, i < 15);
+    CHECK_EQUAL(history.length(), 1);
+    CHECK_EQUAL(history.age(), 0);
+    CHECK(history.get(0, &bucket));
+    CHECK_EQUAL(bucket.roomMin, 20);
+    CHECK_EQUAL(bucket.roomMax, 21);
+    CHECK_EQUAL(bucket.roomAvg, 21);        // 20.5 rounded half away from zero
+    CHECK_EQUAL(bucket.outsideMin, -4);
+    CHECK_EQUAL(bucket.outsideMax, -3);
+    CHECK_EQUAL(bucket.outsideAvg, -4);     // -3.5
+    CHECK_EQUAL(bucket.duty, 25);
+    CHECK_EQUAL(bucket.coverage, 100);
+
+    for (uint8_t i=0; i<60; i++) history.sample(i < 30, 25, 10, true);     // half of bucket without data
+    CHECK(history.get(0, &bucket));
+    CHECK_EQUAL(bucket.roomAvg, 25);
+    CHECK_EQUAL(bucket.duty, 100);
+    CHECK_EQUAL(bucket.coverage, 50);
+
+    for (uint8_t i=0; i<60; i++) history.sample(false, 0, 0, false);
+    CHECK(history.get(0, &bucket));
+    CHECK_EQUAL(bucket.coverage, 0);
+
+    for (uint8_t i=0; i<90; i++) history.sample(true, 30, 30, false);      // oldest bucket overwritten, half of next one
+    CHECK_EQUAL(history.length(), 3);
+    CHECK_EQUAL(history.age(), 30);
+    CHECK(history.get(0, &bucket));
+    CHECK_EQUAL(bucket.roomAvg, 30);
+    CHECK(history.get(2, &bucket));
+    CHECK_EQUAL(bucket.roomAvg, 25);
+    CHECK(!history.get(3, &bucket));
+
+    TestRig<> rig;      // run.sh enables history of instances with 60 fine and 8 coarse buckets
+    rig.run(CONNECT_TIME + 180000);
+    CHECK(rig.hvac.getHistoryLength(HISTORY_FINE) >= 2);     // sampled when handleHvac runs
+    CHECK(rig.hvac.getHistory(HISTORY_FINE, 0, &bucket));
+    CHECK_EQUAL(bucket.roomAvg, 26);
+    CHECK_EQUAL(rig.hvac.getHistoryLength(HISTORY_COARSE), 0);
+}
+
+// generation moves on visible changes only, answers with same values keep it
+static void testGeneration(void) {
+    TestRig<> rig;
+    CHECK_EQUAL(rig.hvac.getGeneration(), 0);
+    rig.run(CONNECT_TIME);
+    uint32_t generation = rig.hvac.getGeneration();
+    CHECK(generation > 0);  // connected and query all decoded
+    rig.run(60000);         // temperature polls, same values
+    CHECK(!rig.hvac.changedSince(generation));
+
+    rig.hvac.setSetpoint(22);
+    rig.run(3000);
+    CHECK(rig.hvac.changedSince(generation));
+    CHECK(rig.hvac.getGeneration() > generation);
+    generation = rig.hvac.getGeneration();
+    rig.hvac.setSetpoint(22);   // unit has it already
+    rig.run(3000);
+    CHECK(!rig.hvac.changedSince(generation));
+
+    rig.port.mute = true;   // connection lost
+    rig.run(180000);
+    CHECK(!rig.hvac.isConnected());
+    CHECK(rig.hvac.changedSince(generation));
+}
+
+// query all starts with the group query and skips functions its reply carried
+static void testPlanner(void) {
+    TestRig<> rig;
+    rig.port.record = true;
+    rig.run(CONNECT_TIME);
+    rig.port.record = false;
+    uint8_t first = 0;
+    CHECK(countQueries(&rig.port, 0, &first) >= 11);
+    CHECK_EQUAL(first, 248);
+    CHECK_EQUAL(countQueries(&rig.port, 248), 1);
+    const uint8_t group[4] = {176, 179, 160, 247};
+    for (uint8_t i=0; i<4; i++) CHECK_EQUAL(countQueries(&rig.port, group[i]), 0);
+    CHECK_EQUAL(countQueries(&rig.port, 135), 1);
+    CHECK_EQUAL(rig.hvac.getSetpoint(), 24);
+    CHECK(!strcmp(rig.hvac.getMode(), "cool"));
+    CHECK(!strcmp(rig.hvac.getOperation(), "normal"));
+
+    rig.port.writtenLength = 0;
+    rig.port.record = true;
+    rig.hvac.forceQueryAllData();
+    rig.run(CONNECT_TIME);
+    CHECK_EQUAL(countQueries(&rig.port, 248), 1);
+    CHECK_EQUAL(countQueries(&rig.port, 179), 0);
+    CHECK_EQUAL(countQueries(&rig.port, 135), 1);
+}
+
+// up to 4 queries outstanding, a query lost on the line is sent again and dropped after 2 retries
+static void testPipeline(void) {
+    TestRig<> rig;
+    rig.hvac.setQueryPipeline(8);
+    CHECK_EQUAL(rig.hvac.getQueryPipeline(), MAX_QUERY_PIPELINE);
+    rig.port.unit.loseQuery = 135;
+    rig.port.unit.loseCount = 1;
+    rig.port.record = true;
+    rig.run(CONNECT_TIME);
+    rig.port.record = false;
+    CHECK_EQUAL(countQueries(&rig.port, 135), 2);
+    CHECK(!strcmp(rig.hvac.getPowerSelect(), "100%"));
+    CHECK_EQUAL(countQueries(&rig.port, 179), 0);      // group reply
+
+    rig.port.unit.loseQuery = 163;
+    rig.port.unit.loseCount = 3;
+    rig.port.writtenLength = 0;
+    rig.port.record = true;
+    rig.hvac.forceQueryAllData();
+    rig.run(CONNECT_TIME);
+    rig.port.record = false;
+    CHECK_EQUAL(countQueries(&rig.port, 163), 3);
+    CHECK_EQUAL(countQueries(&rig.port, 135), 1);
+}
+
+// with a time budget no call blocks, handshake and queries are spread over calls
+static void testBudget(void) {
+    TestRig<> blocking;
+    blocking.run(CONNECT_TIME);
+    CHECK(blocking.hvac.isConnected());
+    CHECK(blocking.longest > 2000);     // handshake and query all wait with delay()
+
+    testClock = 0;
+    TestRig<> rig;
+    rig.budget = 2000;
+    rig.run(CONNECT_TIME);
+    CHECK(rig.hvac.isConnected());
+    CHECK(rig.longest <= rig.budget);
+    rig.run(5000);
+    CHECK_EQUAL(rig.hvac.getPendingWork(), 0);
+    CHECK(!strcmp(rig.hvac.getMode(), "cool"));
+    rig.hvac.setSetpoint(22);
+    rig.run(3000);
+    CHECK_EQUAL(rig.port.unit.get(179), 22);
+    CHECK(rig.longest <= rig.budget);
+}
+
+static void testSchedule(void) {
+    HvacSchedule<4> schedule;
+    CHECK_EQUAL(schedule.next(0), 0);   // empty
+
+    hvacScheduleEntry entry {};
+    entry.days = SCHEDULE_MONDAY;
+    entry.minute = 450;     // 07:30
+    CHECK_EQUAL(schedule.add(&entry), 0);
+    CHECK_EQUAL(schedule.next(0), 450 * 60);
+    CHECK_EQUAL(schedule.next(450 * 60), HVAC_SECONDS_PER_WEEK);            // due now, next is one week later
+    CHECK_EQUAL(schedule.next(450 * 60 - 1), 1);
+    CHECK_EQUAL(schedule.next(6 * HVAC_SECONDS_PER_DAY + 23 * 3600), 3600 + 450 * 60);    // Sunday 23:00, over week end
+
+    entry.days = SCHEDULE_WEEKDAYS;
+    entry.minute = 1320;    // 22:00
+    CHECK_EQUAL(schedule.add(&entry), 1);
+    CHECK_EQUAL(schedule.next(450 * 60), (1320 - 450) * 60);
+    CHECK_EQUAL(schedule.next(4 * HVAC_SECONDS_PER_DAY + 1320 * 60), 2 * HVAC_SECONDS_PER_DAY + 2 * 3600 + 450 * 60);    // Friday 22:00 to Monday 07:30
+
+    // due after "from" up to and including "to", in order they were due
+    uint8_t slots[4];
+    CHECK_EQUAL(schedule.due(0, 1320 * 60, slots), 2);
+    CHECK_EQUAL(slots[0], 0);
+    CHECK_EQUAL(slots[1], 1);
+    CHECK_EQUAL(schedule.due(450 * 60, 1320 * 60 - 1, slots), 0);
+    CHECK_EQUAL(schedule.due(HVAC_SECONDS_PER_WEEK - 60, 450 * 60, slots), 1);   // window over week end
+
+    entry.days = 0;
+    CHECK_EQUAL(schedule.add(&entry), -1);
+    entry.days = SCHEDULE_SUNDAY;
+    entry.minute = 1440;
+    CHECK_EQUAL(schedule.add(&entry), -1);
+    CHECK(schedule.remove(0));
+    CHECK(!schedule.remove(0));
+    CHECK_EQUAL(schedule.next(0), 1320 * 60);
+}
+
+// burst of COMMAND_BURST settings, then one setting per 60000 / rate ms
+static void testTokenBucket(void) {
+    TestRig<> rig;
+    rig.run(CONNECT_TIME);
+    rig.hvac.setCommandRate(6);
+    rig.hvac.setCoalesceDelay(0);
+    rig.hvac.setState("off");
+    rig.hvac.setSetpoint(20);
+    rig.hvac.setMode("heat");
+    rig.hvac.setFanMode("lvl_3");
+    rig.hvac.setSwing("h_swing");
+    rig.hvac.setPowerSelect("50%");
+    rig.hvac.setOperation("eco");
+    rig.run(4500);    // 5 settings, 600 ms apart
+    CHECK_EQUAL(rig.hvac.getWriteStats().sent, 5);
+    rig.run(6000);    // token 10 s after start
+    CHECK_EQUAL(rig.hvac.getWriteStats().sent, 6);
+    rig.run(10000);
+    CHECK_EQUAL(rig.hvac.getWriteStats().sent, 7);
+    CHECK_EQUAL(rig.port.unit.get(135), 50);
+    CHECK_EQUAL(rig.port.unit.get(247), 3);     // eco
+    rig.hvac.setSetpoint(35);   // clamped to the range of the mode, the clamp sends nothing and takes no token
+    rig.run(10500);
+    CHECK_EQUAL(rig.hvac.getWriteStats().sent, 8);
+    CHECK_EQUAL(rig.port.unit.get(179), 30);
+}
+
+// settings not queued while TX ring is full take no command token and are not counted as sent
+static void testTxFull(void) {
+    TestRig<> rig;
+    rig.run(CONNECT_TIME);
+    rig.hvac.setCommandRate(1);     // 5 tokens, next one a minute later
+    rig.hvac.setCoalesceDelay(0);
+    rig.port.space = 0;
+    const byte query[14] = HVAC_QUERY_PACKET(187);
+    byte packet[14];
+    memcpy(packet, query, sizeof(query));
+    while (rig.hvac.sendCustomPacket(packet, sizeof(packet)));   // fill the ring
+    rig.hvac.setSetpoint(20);
+    rig.hvac.setMode("heat");
+    rig.hvac.setFanMode("lvl_3");
+    rig.hvac.setPowerSelect("50%");
+    rig.hvac.setOperation("eco");
+    rig.run(5000);
+    CHECK_EQUAL(rig.hvac.getWriteStats().sent, 0);
+    CHECK_EQUAL(rig.hvac.getWriteStats().throttled, 0);
+    rig.port.space = 64;
+    rig.run(5000);      // all 5 tokens still there
+    CHECK_EQUAL(rig.hvac.getWriteStats().sent, 5);
+    CHECK_EQUAL(rig.hvac.getWriteStats().throttled, 0);
+    CHECK_EQUAL(rig.port.unit.get(179), 20);
+    CHECK_EQUAL(rig.port.unit.get(247), 3);     // eco
+}
+
+// only the latest value of a field changed faster than coalesce delay is sent
+static void testCoalescing(void) {
+    TestRig<> rig;
+    rig.run(CONNECT_TIME);
+    rig.hvac.resetWriteStats();
+    for (uint8_t setpoint=17; setpoint<=23; setpoint++) {     // unit has 24
+        rig.hvac.setSetpoint(setpoint);
+        rig.run(100);
+    }
+    rig.run(2000);
+    hvacWriteStats stats = rig.hvac.getWriteStats();
+    CHECK_EQUAL(stats.sent, 1);
+    CHECK_EQUAL(stats.coalesced, 6);
+    CHECK_EQUAL(rig.port.unit.get(179), 23);
+
+    rig.hvac.setSetpoint(20);   // set and back before sent, unit already has value
+    rig.run(100);
+    rig.hvac.setSetpoint(23);
+    rig.run(2000);
+    stats = rig.hvac.getWriteStats();
+    CHECK_EQUAL(stats.sent, 1);
+    CHECK_EQUAL(stats.dropped, 1);
+}
+
+// sleeping until getNextDeadline loses nothing: few calls while idle, settings are still sent on time
+static void testDeadline(void) {
+    TestRig<> rig;
+    rig.run(CONNECT_TIME + 60000);
+    rig.calls = 0;
+    rig.run(60000);     // one temperature poll
+    CHECK(rig.calls <= 4);
+    CHECK(rig.hvac.getNextDeadline() > 1000);
+    rig.hvac.setSetpoint(22);
+    CHECK(rig.hvac.getNextDeadline() <= 300);     // coalesce delay
+    rig.calls = 0;
+    rig.run(3000);
+    CHECK(rig.calls <= 10);
+    CHECK_EQUAL(rig.port.unit.get(179), 22);
+}
+
+static uint32_t tappedFrames = 0;
+static uint32_t tappedReplies = 0;
+static uint32_t tappedBroken = 0;
+static uint8_t tappedFunction = 0;
+
+// every received frame is seen before decoding, listen only decodes traffic of another device and never transmits
+static void testFrameTap(void) {
+    TestRig<> rig;
+    rig.hvac.setFrameReceivedCallback([](hvacFrame frame) {
+        tappedFrames++;
+        if (!frame.checksum) tappedBroken++;
+        if ((frame.type == 144) && frame.payloadLength) {
+            tappedReplies++;
+            tappedFunction = frame.payload[0];
+        }
+    });
+    rig.run(CONNECT_TIME);
+    CHECK(tappedReplies >= 11);     // query all
+    CHECK(tappedFrames > tappedReplies);
+    CHECK_EQUAL(tappedBroken, 0);
+
+    rig.hvac.setListenOnly(true);
+    CHECK(rig.hvac.isListenOnly());
+    rig.port.record = true;
+    CHECK_EQUAL(rig.hvac.setSetpoint(20).state(), WRITE_INVALID);
+    byte query[14] = HVAC_QUERY_PACKET(179);
+    CHECK(!rig.hvac.sendCustomPacket(query, sizeof(query)));
+
+    byte command[15] = {2, 0, 3, 16, 0, 0, 7, 1, 48, 1, 0, 2, 179, 21, 0};    // other device sets 21 and queries it
+    for (uint8_t i=1; i<14; i++) command[14] -= command[i];
+    rig.port.unit.write(command, sizeof(command));
+    rig.port.unit.write(query, sizeof(query));
+    rig.run(300000);    // polls and a new handshake would have been sent
+    CHECK_EQUAL(rig.port.writtenLength, 0);
+    CHECK_EQUAL(tappedFunction, 179);
+    CHECK_EQUAL(rig.hvac.getSetpoint(), 21);
+}
+
+// functions the unit does not answer are left out of queries and setters, risky functions only probed on request
+static void testProbe(void) {
+    TestRig<> rig;
+    CHECK(!rig.hvac.probeFunctions());  // not connected
+    rig.run(CONNECT_TIME);
+    CHECK_EQUAL(rig.hvac.getFunctionProfile(), 0xFFFF);
+    rig.port.unit.loseQuery = 163;      // unit without swing
+    rig.port.unit.loseCount = 255;
+    rig.port.record = true;
+    CHECK(rig.hvac.probeFunctions());
+    CHECK(rig.hvac.isProbing());
+    CHECK(!rig.hvac.probeFunctions());  // already probing
+    rig.run(15000);     // in background of handleHvac
+    rig.port.record = false;
+    CHECK(!rig.hvac.isProbing());
+    CHECK_EQUAL(countQueries(&rig.port, 163), 3);
+    CHECK_EQUAL(countQueries(&rig.port, 199), 0);
+    uint16_t profile = rig.hvac.getFunctionProfile();
+    CHECK(profile != 0xFFFF);
+    CHECK(!rig.hvac.isFieldSupported(FIELD_SWING));
+    CHECK(!rig.hvac.isFieldSupported(FIELD_PURE));     // not queried, may reboot older models
+    CHECK(!rig.hvac.isFieldSupported(FIELD_WIFILED));
+    CHECK(rig.hvac.isFieldSupported(FIELD_PSEL));
+    CHECK_EQUAL(rig.hvac.setSwing("v_swing").state(), WRITE_INVALID);
+
+    rig.port.writtenLength = 0;
+    rig.port.record = true;
+    rig.hvac.forceQueryAllData();
+    rig.run(CONNECT_TIME);
+    CHECK_EQUAL(countQueries(&rig.port, 163), 0);
+    CHECK_EQUAL(countQueries(&rig.port, 135), 1);
+
+    CHECK(rig.hvac.probeFunctions(true));
+    rig.run(15000);
+    CHECK(rig.hvac.isFieldSupported(FIELD_PURE));
+
+    TestRig<> saved;    // profile set from own storage
+    saved.hvac.setFunctionProfile(profile);
+    CHECK(!saved.hvac.isFieldSupported(FIELD_SWING));
+}
+
+// smoothed rtt follows unit latency, heartbeats not answered bring the link down
+static void testHeartbeat(void) {
+    TestRig<> rig;
+    rig.hvac.setHeartbeat(1000);
+    rig.run(CONNECT_TIME + 30000);
+    hvacLinkStats stats = rig.hvac.getLinkStats();
+    CHECK(stats.sent >= 20);
+    CHECK_EQUAL(stats.lost, 0);
+    CHECK(stats.rtt >= UNIT_LATENCY);
+    CHECK(stats.rtt <= UNIT_LATENCY + 5);
+    CHECK(stats.rttVariance <= 5);
+
+    rig.port.mute = true;
+    rig.run(4000);      // 3 heartbeats of min timeout after interval
+    stats = rig.hvac.getLinkStats();
+    CHECK(stats.lost >= HEARTBEAT_MAX_MISSED);
+    CHECK(!rig.hvac.isConnected());
+    rig.port.mute = false;
+    rig.run(150000);    // handshake sent while muted is sent again after connection timeout (2 minutes)
+    CHECK(rig.hvac.isConnected());
+}
+
+static const HostTest TESTS[20] = {
+    {"poll", testPoll},
+    {"calibrate", testCalibrate},
+    {"warmstart", testWarmStart},
+    {"writes", testWrites},
+    {"events", testEvents},
+    {"txring", testTxRing},
+    {"log", testLog},
+    {"history", testHistory},
+    {"generation", testGeneration},
+    {"planner", testPlanner},
+    {"pipeline", testPipeline},
+    {"budget", testBudget},
+    {"schedule", testSchedule},
+    {"tokenbucket", testTokenBucket},
+    {"txfull", testTxFull},
+    {"coalescing", testCoalescing},
+    {"deadline", testDeadline},
+    {"frametap", testFrameTap},
+    {"probe", testProbe},
+    {"heartbeat", testHeartbeat}
+};
+
+int main(int argc, char* argv[]) {
+    return runTests(TESTS, sizeof(TESTS) / sizeof(TESTS[0]), argc, argv);
+}
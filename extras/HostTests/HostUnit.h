@@ -0,0 +1,146 @@
+/*
+*   Simulated indoor unit, used behind the test port of HostTests, as transport by FleetSim and on the unit side of the pty
+*   pairs in LinuxGateway.
+*   Answers handshake, queries and writes like a unit, replies are released when millis() reaches them.
+*   Include after Arduino.h (millis()).
+*/
+
+#ifndef HostUnit_H
+#define HostUnit_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define UNIT_LATENCY 40         // ms from end of query to reply
+#define UNIT_QUEUE 8            // replies waiting per unit
+
+static const uint8_t UNIT_FUNCTIONS[14] = {128, 135, 144, 148, 160, 163, 176, 179, 187, 190, 199, 222, 223, 247};
+
+// fixed memory, library side is available/readBytes/write like a transport
+class HostUnit {
+    private:
+        struct reply {
+            uint32_t due;
+            uint8_t length;
+            uint8_t data[24];
+        };
+
+        uint8_t _values[14] = {48, 100, 66, 66, 65, 65, 66, 24, 26, 127, 16, 5, 0, 0};
+        uint8_t _in[32];
+        uint8_t _inLength = 0;
+        reply _out[UNIT_QUEUE];
+        uint8_t _outHead = 0;
+        uint8_t _outCount = 0;
+        uint8_t _outRead = 0;   // bytes of head reply already read
+
+        uint8_t* value(uint8_t function) {
+            for (uint8_t i=0; i<sizeof(UNIT_FUNCTIONS); i++) {
+                if (UNIT_FUNCTIONS[i] == function) return &_values[i];
+            }
+            return nullptr;
+        }
+
+        void send(const uint8_t* data, uint8_t length) {
+            if (_outCount >= UNIT_QUEUE) return;    // overrun, like a full line
+            reply* r = &_out[(_outHead + _outCount++) % UNIT_QUEUE];
+            memcpy(r->data, data, length);
+            r->data[6] = length + 1 - 8;
+            uint8_t sum = 0;
+            for (uint8_t i=1; i<length; i++) sum += r->data[i];    // after length byte is set
+            r->data[length] = -sum;
+            r->length = length + 1;
+            r->due = millis() + UNIT_LATENCY;
+            frames++;
+        }
+
+        void sendReply(const uint8_t* payload, uint8_t length) {
+            uint8_t frame[24] = {2, 0, 3, 144, 0, 0, 0, 1, 48, 1, 0, 0, 0, length};
+            memcpy(&frame[14], payload, length);
+            send(frame, 14 + length);
+        }
+
+        void handle(const uint8_t* frame, uint8_t length) {
+            frames++;
+            if ((length == 8) && (frame[1] == 0) && (frame[2] == 2)) {     // SYN -> SYN/ACK
+                const uint8_t synAck[9] = {2, 0, 0, 128, 0, 0, 0, 0, 0};
+                send(synAck, sizeof(synAck));
+            } else if ((length == 10) && (frame[2] == 2) && (frame[3] == 2)) {     // ACK -> ready
+                const uint8_t ready[14] = {2, 0, 3, 17, 0, 0, 0, 1, 48, 1, 0, 2, 136, 66};
+                send(ready, sizeof(ready));
+            } else if ((frame[2] == 3) && (frame[3] == 16)) {
+                if ((frame[11] == 1) && (frame[12] == loseQuery) && loseCount) {
+                    loseCount--;
+                } else if (frame[11] == 1) {
+                    if (frame[12] == 248) {
+                        const uint8_t group[5] = {248, *value(176), *value(179), *value(160), *value(247)};
+                        sendReply(group, sizeof(group));
+                    } else if (value(frame[12])) {
+                        const uint8_t single[2] = {frame[12], *value(frame[12])};
+                        sendReply(single, sizeof(single));
+                    }
+                } else if ((frame[11] == 2) && value(frame[12])) {
+                    *value(frame[12]) = frame[13];
+                    sendReply(&frame[12], 1);   // setting changed
+                }
+            }
+        }
+
+    public:
+        uint32_t frames = 0;    // received and sent
+        uint8_t loseQuery = 0;  // next loseCount queries of this function are lost on the line
+        uint8_t loseCount = 0;
+
+        uint8_t get(uint8_t function) { return *value(function); }
+        void set(uint8_t function, uint8_t newValue) { *value(function) = newValue; }    // changed by remote or sensor, no feedback
+
+        // ms until next reply byte can be read, 0xFFFFFFFF when nothing is queued
+        uint32_t nextArrival(void) {
+            if (!_outCount) return 0xFFFFFFFF;
+            uint32_t now = millis();
+            int32_t wait = (int32_t)(_out[_outHead].due - now);
+            return wait > 0 ? wait : 0;
+        }
+
+        int available(void) {
+            int count = 0;
+            uint32_t now = millis();
+            for (uint8_t i=0; i<_outCount; i++) {
+                const reply* r = &_out[(_outHead + i) % UNIT_QUEUE];
+                if ((int32_t)(now - r->due) < 0) break;
+                count += r->length - (i ? 0 : _outRead);
+            }
+            return count;
+        }
+
+        size_t readBytes(uint8_t data[], size_t length) {
+            size_t count = 0;
+            uint32_t now = millis();
+            while ((count < length) && _outCount && ((int32_t)(now - _out[_outHead].due) >= 0)) {
+                reply* r = &_out[_outHead];
+                data[count++] = r->data[_outRead++];
+                if (_outRead == r->length) {
+                    _outRead = 0;
+                    _outHead = (_outHead + 1) % UNIT_QUEUE;
+                    _outCount--;
+                }
+            }
+            return count;
+        }
+
+        size_t write(const uint8_t data[], size_t length) {
+            for (size_t i=0; i<length; i++) {
+                if (!_inLength && (data[i] != 2)) continue;    // wait for start byte
+                if (_inLength < sizeof(_in)) _in[_inLength++] = data[i];
+                if (_inLength < 8) continue;
+                uint8_t frameLength = (_in[1] == 255) ? ((_in[3] == 0) ? 8 : 9) : (_in[6] + 8);
+                if (_inLength < frameLength) continue;
+                handle(_in, frameLength);
+                _inLength = 0;
+            }
+            return length;
+        }
+
+        int availableForWrite(void) { return 64; }
+};
+
+#endif // HostUnit_H
@@ -0,0 +1,22 @@
+#!/bin/sh
+# Build HostTests with the host compiler and run them (history enabled), FeatureTests is built with HVAC_FEATURES 0 and defaults
+# needs: g++ with C++11 (Linux)
+# usage: extras/HostTests/run.sh [test name], extra compiler flags in CXXFLAGS (e.g. -fsanitize=address,undefined)
+set -e
+
+TEST_DIR=$(cd "$(dirname "$0")" && pwd)
+LIBRARY_DIR=$(cd "$TEST_DIR/../.." && pwd)
+BUILD_DIR="$TEST_DIR/build"
+
+mkdir -p "$BUILD_DIR"
+g++ -std=gnu++11 -O2 -DARDUINO=100 -DHISTORY_FINE_BUCKETS=60 -DHISTORY_COARSE_BUCKETS=8 $CXXFLAGS \
+    -I"$TEST_DIR" -I"$LIBRARY_DIR/src" \
+    -o "$BUILD_DIR/host_tests" \
+    "$TEST_DIR/HostTests.cpp" "$LIBRARY_DIR"/src/*.cpp
+g++ -std=gnu++11 -O2 -DARDUINO=100 -DHVAC_FEATURES=0 $CXXFLAGS \
+    -I"$TEST_DIR" -I"$LIBRARY_DIR/src" \
+    -o "$BUILD_DIR/feature_tests" \
+    "$TEST_DIR/FeatureTests.cpp" "$LIBRARY_DIR"/src/*.cpp
+
+if [ "$1" != "features" ]; then "$BUILD_DIR/host_tests" "$@"; fi
+if [ -z "$1" ] || [ "$1" = "features" ]; then "$BUILD_DIR/feature_tests" "$@"; fi
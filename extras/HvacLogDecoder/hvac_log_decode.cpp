@@ -0,0 +1,46 @@
+/*
+*   Decode binary log written by hvac.dumpLog()
+*   build: g++ -std=c++11 -O2 -o hvac_log_decode hvac_log_decode.cpp
+*   usage: hvac_log_decode log.bin     (or read from stdin)
+*   log must be dumped by the same library version, event IDs are only appended between versions
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "../../src/HvacLog.h"
+
+// same order as hvacField
+static const char* const FIELD_NAME[15] = {"STATE", "SETPOINT", "MODE", "SWING", "FANMODE", "PURE", "PSEL", "OP", "WIFILED",
+                                           "ROOMTEMP", "OUTSIDETEMP", "OFFTIMER", "ONTIMER", "CDU_STATE", "UNKNOWN"};
+
+int main(int argc, char* argv[]) {
+    FILE* in = stdin;
+    if ((argc > 1) && !(in = fopen(argv[1], "rb"))) {
+        perror(argv[1]);
+        return 1;
+    }
+    uint8_t header[6];
+    if ((fread(header, 1, sizeof(header), in) != sizeof(header)) || memcmp(header, HVAC_LOG_MAGIC, 3)) {
+        fprintf(stderr, "not a hvac log\n");
+        return 1;
+    }
+    if (header[3] != HVAC_LOG_VERSION) {
+        fprintf(stderr, "log version %d not supported\n", header[3]);
+        return 1;
+    }
+    printf("# dropped before dump: %u\n", header[4] | (header[5] << 8));
+
+    uint8_t data[HVAC_LOG_RECORD_SIZE];
+    uint32_t count = 0, first = 0;
+    while (fread(data, 1, sizeof(data), in) == sizeof(data)) {
+        hvacLogRecord record;
+        char text[160];
+        hvacUnpackLogRecord(data, &record);
+        if (!count++) first = record.time;
+        hvacFormatLogRecord(text, sizeof(text), &record, FIELD_NAME, 15);
+        printf("%10u us  +%9u  %-5s  %s\n", record.time, record.time - first, hvacLogLevelName(hvacLogLevelOf(record.event)), text);
+    }
+    printf("# %u records\n", count);
+    if (in != stdin) fclose(in);
+    return 0;
+}
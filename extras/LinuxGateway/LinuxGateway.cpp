@@ -0,0 +1,188 @@
+/*
+*   Linux gateway: one thread serves many units, one serial port (USB-UART at 9600 8E1) per unit, with HvacEventLoop.
+*   The thread sleeps in epoll_wait until a port has data or the next deadline of an instance, there is no busy polling.
+*   build and run: extras/LinuxGateway/run.sh /dev/ttyUSB0 /dev/ttyUSB1 ... (prints settings and status of every unit)
+*   test without hardware: extras/LinuxGateway/run.sh --pty [units] [seconds]
+*   creates a pty pair per unit, the gateway opens the slave like a serial port and a second thread runs a simulated unit
+*   (extras/HostTests/HostUnit.h) on every master. After PTY_ACTION ms the gateway changes setpoint of every unit,
+*   at the end every unit is checked (connected, setpoint confirmed by unit) and wakeups and CPU time of the gateway
+*   thread are reported, exit code 1 on mismatch. Arduino.h is the host shim of HostTests with HOST_REAL_CLOCK.
+*/
+
+#include <atomic>
+#include <thread>
+#include <stdlib.h>
+#include <pty.h>
+#include "Arduino.h"
+#include <ToshibaCarrierHvac.h>
+#include "HostUnit.h"
+
+#define GATEWAY_UNITS 64        // max units of one event loop
+#define PTY_ACTION 15000        // ms after start, gateway sets setpoint of every unit
+
+class GatewayListener : public HvacListener {
+    public:
+        const char* name = nullptr;     // port, nothing printed when not set
+
+        void onSettings(hvacSettings newSettings) {
+            if (!name) return;
+            printf("%s: state %s setpoint %u mode %s fan %s\n", name, newSettings.state, newSettings.setpoint,
+                newSettings.mode, newSettings.fanMode);
+        }
+
+        void onStatus(hvacStatus newStatus) {
+            if (name) printf("%s: room %d outside %d\n", name, newStatus.roomTemperature, newStatus.outsideTemperature);
+        }
+
+        void onLink(bool up) {
+            if (name) printf("%s: link %s\n", name, up ? "up" : "down");
+        }
+};
+
+typedef ToshibaCarrierHvacT<GatewayListener, HvacFdTransport> GatewayHvac;
+
+struct GatewayUnit {
+    HvacFdTransport port;
+    GatewayHvac hvac;
+
+    GatewayUnit(int fd) : port(fd), hvac(&port) {}
+};
+
+static uint64_t threadCpuMicros(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static int serve(int count, char* paths[]) {
+    HvacEventLoop<GatewayHvac, GATEWAY_UNITS> loop;
+    for (int i=0; i<count; i++) {
+        int fd = hvacOpenSerial(paths[i]);
+        if (fd < 0) {
+            perror(paths[i]);
+            return 1;
+        }
+        GatewayUnit* unit = new GatewayUnit(fd);
+        unit->hvac.listener().name = paths[i];
+        unit->hvac.setHeartbeat(5000);
+        if (!loop.add(&unit->hvac, fd)) {
+            printf("%s: more than %d units\n", paths[i], GATEWAY_UNITS);
+            return 1;
+        }
+    }
+    for (;;) {
+        if (loop.run() < 0) {
+            perror("epoll");
+            return 1;
+        }
+    }
+}
+
+// simulated units on pty masters, own thread so gateway timing is like real ports
+static void runUnits(HostUnit* units, const int* masters, int count, std::atomic<bool>* stop) {
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    for (int i=0; i<count; i++) {
+        struct epoll_event event {};
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, masters[i], &event);
+    }
+    while (!stop->load()) {
+        int timeout = 100;
+        for (int i=0; i<count; i++) {
+            uint32_t arrival = units[i].nextArrival();
+            if (arrival < (uint32_t)timeout) timeout = arrival;
+        }
+        struct epoll_event events[GATEWAY_UNITS];
+        int ready = epoll_wait(epoll, events, GATEWAY_UNITS, timeout);
+        uint8_t data[64];
+        for (int i=0; i<ready; i++) {
+            ssize_t length = read(masters[events[i].data.u32], data, sizeof(data));
+            if (length > 0) units[events[i].data.u32].write(data, length);
+        }
+        for (int i=0; i<count; i++) {
+            size_t length = units[i].readBytes(data, sizeof(data));
+            if (length && (write(masters[i], data, length) < 0)) perror("pty");
+        }
+    }
+    close(epoll);
+}
+
+static int testPty(int count, uint32_t seconds) {
+    if ((count < 1) || (count > GATEWAY_UNITS) || (seconds * 1000 < PTY_ACTION + 10000)) {
+        printf("--pty: 1 to %d units, at least %u seconds\n", GATEWAY_UNITS, (PTY_ACTION + 10000) / 1000);
+        return 2;
+    }
+    int masters[GATEWAY_UNITS];
+    GatewayUnit* gateway[GATEWAY_UNITS];
+    HostUnit* units = new HostUnit[count];
+    HvacEventLoop<GatewayHvac, GATEWAY_UNITS> loop;
+    for (int i=0; i<count; i++) {
+        int slave;
+        char path[64];
+        if (openpty(&masters[i], &slave, path, nullptr, nullptr) < 0) {
+            perror("openpty");
+            return 1;
+        }
+        int fd = hvacOpenSerial(path);     // same as a USB-UART, slave of openpty only keeps pty open
+        if (fd < 0) {
+            perror(path);
+            return 1;
+        }
+        close(slave);
+        gateway[i] = new GatewayUnit(fd);
+        gateway[i]->hvac.setHeartbeat(5000);
+        loop.add(&gateway[i]->hvac, fd);
+    }
+
+    std::atomic<bool> stop(false);
+    std::thread unitThread(runUnits, units, masters, count, &stop);
+    uint32_t start = millis();
+    uint64_t cpuStart = threadCpuMicros();
+    uint32_t runs = 0;
+    bool actionDone = false;
+    for (;;) {
+        uint32_t elapsed = millis() - start;
+        if (elapsed >= seconds * 1000) break;
+        if (!actionDone && (elapsed >= PTY_ACTION)) {
+            for (int i=0; i<count; i++) gateway[i]->hvac.setSetpoint(17 + (i % 14));
+            actionDone = true;
+        }
+        uint32_t until = actionDone ? (seconds * 1000 - elapsed) : (PTY_ACTION - elapsed);
+        int done = loop.run(until);
+        if (done < 0) {
+            perror("epoll");
+            return 1;
+        }
+        runs += done;
+    }
+    uint64_t cpu = threadCpuMicros() - cpuStart;
+    stop = true;
+    unitThread.join();
+
+    int failed = 0;
+    for (int i=0; i<count; i++) {
+        GatewayHvac* hvac = &gateway[i]->hvac;
+        uint8_t wanted = 17 + (i % 14);
+        if (hvac->isConnected() && (hvac->getSetpoint() == wanted) && (units[i].get(179) == wanted)) continue;
+        failed++;
+        printf("unit %d: connected %d setpoint %u/%u/%u\n", i, hvac->isConnected(), hvac->getSetpoint(), units[i].get(179), wanted);
+    }
+    printf("units: %d seconds: %u wakeups: %u (%.1f/s) instance runs: %u gateway CPU: %.3fs (%.2f%%)\n", count, seconds,
+        loop.getWakeups(), (double)loop.getWakeups() / seconds, runs, cpu / 1e6, cpu / 1e4 / seconds);
+    printf("check: %d of %d units wrong\n", failed, count);
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    if ((argc > 1) && !strcmp(argv[1], "--pty")) {
+        int count = (argc > 2) ? atoi(argv[2]) : 24;
+        uint32_t seconds = (argc > 3) ? strtoul(argv[3], nullptr, 10) : 30;
+        return testPty(count, seconds);
+    }
+    if (argc < 2) {
+        printf("usage: %s port... | --pty [units] [seconds]\n", argv[0]);
+        return 2;
+    }
+    return serve(argc - 1, &argv[1]);
+}
@@ -0,0 +1,17 @@
+#!/bin/sh
+# Build LinuxGateway with the host compiler and run it
+# needs: g++ with C++11 and pthread (Linux), libutil (openpty)
+# usage: extras/LinuxGateway/run.sh port... | --pty [units] [seconds], extra compiler flags in CXXFLAGS (e.g. -fsanitize=thread)
+set -e
+
+GATEWAY_DIR=$(cd "$(dirname "$0")" && pwd)
+LIBRARY_DIR=$(cd "$GATEWAY_DIR/../.." && pwd)
+BUILD_DIR="$GATEWAY_DIR/build"
+
+mkdir -p "$BUILD_DIR"
+g++ -std=gnu++11 -O2 -pthread -DARDUINO=100 -DHOST_REAL_CLOCK $CXXFLAGS \
+    -I"$LIBRARY_DIR/extras/HostTests" -I"$LIBRARY_DIR/src" \
+    -o "$BUILD_DIR/linux_gateway" \
+    "$GATEWAY_DIR/LinuxGateway.cpp" "$LIBRARY_DIR"/src/*.cpp -lutil
+
+"$BUILD_DIR/linux_gateway" "$@"
@@ -0,0 +1,122 @@
+#ifndef HvacEventLoop_H
+#define HvacEventLoop_H
+
+#if defined(__linux__)
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+// us per handleHvac call, with a budget handshake and queries of one instance don't block the others with delay()
+#if !defined(HVAC_LOOP_BUDGET)
+    #define HVAC_LOOP_BUDGET 2000
+#endif
+
+// ms, longest sleep to one deadline, larger deadlines are cut so int timeout and wrap of millis() stay safe
+#if !defined(HVAC_LOOP_MAX_WAIT)
+    #define HVAC_LOOP_MAX_WAIT 60000
+#endif
+
+// one thread serving many instances (e.g. one USB-UART per unit on a Linux gateway): sleeps in epoll_wait until a port
+// has data or the earliest getNextDeadline() is reached, then runs only instances with data or a due deadline.
+// Hvac is ToshibaCarrierHvacT<...>, fd is the port of its transport (HvacFdTransport, opened with hvacOpenSerial()).
+template<class Hvac, uint8_t SIZE = 32>
+class HvacEventLoop {
+    private:
+        struct entry {
+            Hvac* hvac;
+            int fd;             // -1 after hang up (USB adapter removed), instance still runs on deadlines
+            uint32_t due;       // millis() of next deadline
+            bool timer;         // false when getNextDeadline() had nothing scheduled, runs only on data
+            bool ready;         // data received or not run yet
+        };
+        entry _entries[SIZE];
+        uint8_t _count = 0;
+        int _epoll;
+        uint32_t _budget = HVAC_LOOP_BUDGET;
+        uint32_t _wakeups = 0;
+
+        entry* find(int fd) {
+            for (uint8_t i=0; i<_count; i++) {
+                if (_entries[i].fd == fd) return &_entries[i];
+            }
+            return nullptr;
+        }
+
+    public:
+        HvacEventLoop() : _epoll(epoll_create1(EPOLL_CLOEXEC)) {}
+        ~HvacEventLoop() { if (_epoll >= 0) close(_epoll); }
+
+        int fd(void) { return _epoll; }     // readable when an instance has data, add it to another poll loop
+        uint8_t size(void) { return _count; }
+        uint32_t getWakeups(void) { return _wakeups; }
+        void setBudget(uint32_t maxMicros) { _budget = maxMicros; }
+
+        bool add(Hvac* hvac, int fd) {
+            if ((_epoll < 0) || (_count >= SIZE) || find(fd)) return false;
+            struct epoll_event event {};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event) < 0) return false;
+            _entries[_count++] = entry {hvac, fd, millis(), true, true};
+            return true;
+        }
+
+        bool remove(Hvac* hvac) {
+            for (uint8_t i=0; i<_count; i++) {
+                if (_entries[i].hvac != hvac) continue;
+                if (_entries[i].fd >= 0) epoll_ctl(_epoll, EPOLL_CTL_DEL, _entries[i].fd, nullptr);
+                _entries[i] = _entries[--_count];
+                return true;
+            }
+            return false;
+        }
+
+        // ms until next deadline of any instance, 0 = run now, -1 = no instance has a deadline
+        int getTimeout(void) {
+            uint32_t now = millis();
+            int timeout = -1;
+            for (uint8_t i=0; i<_count; i++) {
+                if (!_entries[i].ready && !_entries[i].timer) continue;
+                int32_t wait = _entries[i].ready ? 0 : (int32_t)(_entries[i].due - now);
+                if (wait < 0) wait = 0;
+                if ((timeout < 0) || (wait < timeout)) timeout = wait;
+            }
+            return timeout;
+        }
+
+        // wait up to maxWait ms (-1 = until data or deadline) and run instances with work, returns instances run, -1 on error
+        int run(int maxWait = -1) {
+            int timeout = getTimeout();
+            if ((maxWait >= 0) && ((timeout < 0) || (maxWait < timeout))) timeout = maxWait;
+            struct epoll_event events[SIZE];
+            int count = epoll_wait(_epoll, events, SIZE, timeout);
+            if (count < 0) return (errno == EINTR) ? 0 : -1;
+            _wakeups++;
+            for (int i=0; i<count; i++) {
+                entry* e = find(events[i].data.fd);
+                if (!e) continue;
+                e->ready = true;
+                if (events[i].events & (EPOLLHUP | EPOLLERR)) {     // level triggered, would wake every call
+                    epoll_ctl(_epoll, EPOLL_CTL_DEL, e->fd, nullptr);
+                    e->fd = -1;
+                }
+            }
+            uint32_t now = millis();
+            int done = 0;
+            for (uint8_t i=0; i<_count; i++) {
+                entry* e = &_entries[i];
+                if (!e->ready && (!e->timer || ((int32_t)(now - e->due) < 0))) continue;
+                e->hvac->handleHvac(_budget);
+                uint32_t next = e->hvac->getNextDeadline();
+                e->timer = (next != 0xFFFFFFFF);
+                e->due = millis() + ((next > HVAC_LOOP_MAX_WAIT) ? HVAC_LOOP_MAX_WAIT : next);
+                e->ready = false;
+                done++;
+            }
+            return done;
+        }
+};
+#endif
+
+#endif // HvacEventLoop_H
@@ -0,0 +1,106 @@
+#ifndef HvacHistory_H
+#define HvacHistory_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HVAC_HISTORY_MAGIC "HVH"        // binary export header, followed by version, bucket minutes, count(2) and age(2) of newest bucket in seconds
+#define HVAC_HISTORY_VERSION 1
+#define HVAC_HISTORY_BUCKET_SIZE 8      // bytes per bucket in binary export, same order as hvacHistoryBucket
+
+// history resolution
+enum hvacHistoryResolution {
+    HISTORY_FINE,
+    HISTORY_COARSE
+};
+
+// temperature and compressor duty over bucket time
+struct hvacHistoryBucket {
+    int8_t roomMin;
+    int8_t roomMax;
+    int8_t roomAvg;
+    int8_t outsideMin;
+    int8_t outsideMax;
+    int8_t outsideAvg;
+    uint8_t duty;       // percent of time CDU running
+    uint8_t coverage;   // percent of time with data (connected), 0 = no data
+};
+
+// fixed-memory history at one resolution, sampled once per second, newest buckets overwrite oldest
+template<uint16_t SIZE>
+class HvacHistoryLevel {
+    private:
+        hvacHistoryBucket _buckets[SIZE];
+        uint16_t _minutes;
+        uint16_t _head = 0;     // next bucket to write
+        uint16_t _count = 0;
+        uint16_t _seconds = 0;  // of current bucket
+        uint16_t _samples = 0;
+        uint16_t _running = 0;
+        int32_t _roomSum = 0;
+        int32_t _outsideSum = 0;
+        int8_t _roomMin = 0;
+        int8_t _roomMax = 0;
+        int8_t _outsideMin = 0;
+        int8_t _outsideMax = 0;
+
+        void close(void) {
+            hvacHistoryBucket* bucket = &_buckets[_head];
+            if (_samples) {
+                bucket->roomMin = _roomMin;
+                bucket->roomMax = _roomMax;
+                bucket->roomAvg = (_roomSum + ((_roomSum < 0) ? -(_samples / 2) : (_samples / 2))) / _samples;
+                bucket->outsideMin = _outsideMin;
+                bucket->outsideMax = _outsideMax;
+                bucket->outsideAvg = (_outsideSum + ((_outsideSum < 0) ? -(_samples / 2) : (_samples / 2))) / _samples;
+                bucket->duty = ((uint32_t)_running * 100 + (_samples / 2)) / _samples;
+            } else *bucket = hvacHistoryBucket {};
+            bucket->coverage = ((uint32_t)_samples * 100) / ((uint32_t)_minutes * 60);
+            _head = (_head + 1) % SIZE;
+            if (_count < SIZE) _count++;
+            _seconds = _samples = _running = 0;
+            _roomSum = _outsideSum = 0;
+        }
+
+    public:
+        HvacHistoryLevel(uint16_t minutes) : _minutes(minutes) {}
+
+        void sample(bool valid, int8_t room, int8_t outside, bool running) {
+            if (valid) {
+                if (!_samples || (room < _roomMin)) _roomMin = room;
+                if (!_samples || (room > _roomMax)) _roomMax = room;
+                if (!_samples || (outside < _outsideMin)) _outsideMin = outside;
+                if (!_samples || (outside > _outsideMax)) _outsideMax = outside;
+                _roomSum += room;
+                _outsideSum += outside;
+                if (running) _running++;
+                _samples++;
+            }
+            if (++_seconds >= (_minutes * 60)) close();
+        }
+
+        uint16_t minutes(void) const { return _minutes; }
+        uint16_t length(void) const { return _count; }
+        uint16_t age(void) const { return _seconds; }     // seconds since newest bucket closed
+
+        bool get(uint16_t age, hvacHistoryBucket* bucket) const {    // age 0 = newest
+            if (age >= _count) return false;
+            *bucket = _buckets[(_head + SIZE - 1 - age) % SIZE];
+            return true;
+        }
+};
+
+// serialize bucket for binary export, returns HVAC_HISTORY_BUCKET_SIZE
+inline size_t hvacPackHistoryBucket(const hvacHistoryBucket* bucket, uint8_t data[]) {
+    data[0] = bucket->roomMin;
+    data[1] = bucket->roomMax;
+    data[2] = bucket->roomAvg;
+    data[3] = bucket->outsideMin;
+    data[4] = bucket->outsideMax;
+    data[5] = bucket->outsideAvg;
+    data[6] = bucket->duty;
+    data[7] = bucket->coverage;
+    return HVAC_HISTORY_BUCKET_SIZE;
+}
+
+#endif // HvacHistory_H
@@ -0,0 +1,182 @@
+#ifndef HvacLog_H
+#define HvacLog_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// log records are kept in RAM as event ID and up to 3 integer args, text is only formatted when log is drained
+// (on device with printLog() or on host with extras/HvacLogDecoder from a binary dump of dumpLog())
+
+#if defined(__AVR__)
+    #include <avr/pgmspace.h>
+    #define HVAC_LOG_PROGMEM PROGMEM
+    #define HVAC_LOG_READ_BYTE(address) pgm_read_byte(address)
+#else
+    #define HVAC_LOG_PROGMEM
+    #define HVAC_LOG_READ_BYTE(address) (*(address))
+#endif
+
+#define HVAC_LOG_MAGIC "HVL"        // binary dump header, followed by version and dropped record count
+#define HVAC_LOG_VERSION 1
+#define HVAC_LOG_RECORD_SIZE 11     // time(4) event(1) args(3x2), little endian
+
+enum hvacLogLevel {
+    HVAC_LOG_NONE,
+    HVAC_LOG_ERROR,
+    HVAC_LOG_WARN,
+    HVAC_LOG_INFO,
+    HVAC_LOG_DEBUG,
+    HVAC_LOG_TRACE
+};
+
+// event, level, text. %d is replaced by next arg, %f by field name of next arg. Append only, IDs are in binary logs
+#define HVAC_LOG_EVENTS(EVENT) \
+    EVENT(HVAC_EV_TX, HVAC_LOG_TRACE, "Sending packet length %d type %d function %d") \
+    EVENT(HVAC_EV_TX_FULL, HVAC_LOG_WARN, "TX buffer full, packet length %d dropped") \
+    EVENT(HVAC_EV_RX, HVAC_LOG_TRACE, "Received %d bytes, buffered %d") \
+    EVENT(HVAC_EV_RX_SKIP, HVAC_LOG_DEBUG, "Header of packet not found, skip byte %d") \
+    EVENT(HVAC_EV_RX_LARGE, HVAC_LOG_WARN, "Received large packet length %d, dropped") \
+    EVENT(HVAC_EV_RX_INCOMPLETE, HVAC_LOG_WARN, "Packet incomplete, %d bytes dropped") \
+    EVENT(HVAC_EV_FEEDBACK, HVAC_LOG_TRACE, "Received feedback length %d data %d %d") \
+    EVENT(HVAC_EV_FEEDBACK_MAX, HVAC_LOG_INFO, "Max feedback count reached, sending temperature query") \
+    EVENT(HVAC_EV_REPLY, HVAC_LOG_TRACE, "Received reply length %d data %d %d") \
+    EVENT(HVAC_EV_SYNACK, HVAC_LOG_INFO, "Received handshake SYN/ACK") \
+    EVENT(HVAC_EV_ACK, HVAC_LOG_WARN, "Received confirm handshake, your code may crash or hw problem cause node mcu restarted") \
+    EVENT(HVAC_EV_UNKNOWN_PACKET, HVAC_LOG_DEBUG, "Received packet type %d, ignored") \
+    EVENT(HVAC_EV_HANDSHAKE, HVAC_LOG_INFO, "First handshake sent. Waiting for SYN/ACK packet") \
+    EVENT(HVAC_EV_WAIT_READY, HVAC_LOG_INFO, "Waiting for ready feedback") \
+    EVENT(HVAC_EV_READY, HVAC_LOG_INFO, "Status-> READY") \
+    EVENT(HVAC_EV_UNKNOWN_STATUS, HVAC_LOG_WARN, "Status-> %d") \
+    EVENT(HVAC_EV_NOT_CONNECTED, HVAC_LOG_WARN, "Received data when not connected, skipped") \
+    EVENT(HVAC_EV_GROUP, HVAC_LOG_DEBUG, "Process data group %d") \
+    EVENT(HVAC_EV_UNKNOWN_GROUP, HVAC_LOG_WARN, "Received unknown data group %d") \
+    EVENT(HVAC_EV_UNKNOWN_FUNCTION, HVAC_LOG_WARN, "Received unknown function %d, skipped") \
+    EVENT(HVAC_EV_UNKNOWN_DATA, HVAC_LOG_WARN, "Received unknown data length %d, ignored") \
+    EVENT(HVAC_EV_FIELD, HVAC_LOG_DEBUG, "Process data result: %f-> %d") \
+    EVENT(HVAC_EV_OUTSIDE_SKIPPED, HVAC_LOG_DEBUG, "Not update outside temperature, condensing unit not running") \
+    EVENT(HVAC_EV_SETTING_CHANGED, HVAC_LOG_DEBUG, "Received setting changed reply-> %f") \
+    EVENT(HVAC_EV_USER_SETTING, HVAC_LOG_DEBUG, "User wanted %f-> %d") \
+    EVENT(HVAC_EV_SETPOINT_RANGE, HVAC_LOG_WARN, "User wanted setpoint %d out of range, set to %d") \
+    EVENT(HVAC_EV_SETTING_SENT, HVAC_LOG_DEBUG, "New setting has been sync, waiting for reply") \
+    EVENT(HVAC_EV_POLL, HVAC_LOG_DEBUG, "Poll interval reached") \
+    EVENT(HVAC_EV_POLL_INTERVAL, HVAC_LOG_DEBUG, "Next temperature query in(s): %d") \
+    EVENT(HVAC_EV_CONNECTION_TIMEOUT, HVAC_LOG_WARN, "Connection timeout, try to send new handshake") \
+    EVENT(HVAC_EV_CALIBRATE_START, HVAC_LOG_INFO, "Start pacing calibration") \
+    EVENT(HVAC_EV_CALIBRATE_PROBE, HVAC_LOG_DEBUG, "Calibrate settings(%d) delay(ms): %d ok: %d") \
+    EVENT(HVAC_EV_CALIBRATE_DONE, HVAC_LOG_INFO, "Pacing calibrated, latency(ms): %d, query delay(ms): %d, settings delay(ms): %d") \
+    EVENT(HVAC_EV_CACHE_INVALID, HVAC_LOG_INFO, "No valid cache in storage") \
+    EVENT(HVAC_EV_CACHE_LOADED, HVAC_LOG_INFO, "Cached state loaded") \
+    EVENT(HVAC_EV_CACHE_SAVED, HVAC_LOG_DEBUG, "State saved to storage") \
+    EVENT(HVAC_EV_WARM_START, HVAC_LOG_INFO, "Warm start, revalidate cached state") \
+    EVENT(HVAC_EV_WRITE_NO_SLOT, HVAC_LOG_WARN, "No free write slot, write will not be confirmed") \
+    EVENT(HVAC_EV_WRITE_FINISHED, HVAC_LOG_DEBUG, "Write finished with state-> %d") \
+    EVENT(HVAC_EV_QUERYALL, HVAC_LOG_INFO, "Query all sent %d queries, %d already received") \
+    EVENT(HVAC_EV_QUERY_RETRY, HVAC_LOG_DEBUG, "Query %d not answered, sent again") \
+    EVENT(HVAC_EV_QUERY_DROPPED, HVAC_LOG_WARN, "Query %d not answered, dropped") \
+    EVENT(HVAC_EV_SCHEDULE, HVAC_LOG_INFO, "Schedule %d applied (%d:%d)") \
+    EVENT(HVAC_EV_SETTING_COALESCED, HVAC_LOG_DEBUG, "Unsent %f replaced by newer value") \
+    EVENT(HVAC_EV_SETTING_DROPPED, HVAC_LOG_DEBUG, "Unsent %f dropped, unit already has value") \
+    EVENT(HVAC_EV_COMMAND_THROTTLED, HVAC_LOG_WARN, "Command rate limit reached, setting delayed") \
+    EVENT(HVAC_EV_COMMAND, HVAC_LOG_TRACE, "Received command of other device length %d data %d %d") \
+    EVENT(HVAC_EV_LISTEN_ONLY, HVAC_LOG_INFO, "Listen only-> %d") \
+    EVENT(HVAC_EV_TX_LISTEN_ONLY, HVAC_LOG_DEBUG, "Listen only, packet length %d not sent") \
+    EVENT(HVAC_EV_WRITE_LISTEN_ONLY, HVAC_LOG_WARN, "Listen only, write rejected") \
+    EVENT(HVAC_EV_PROBE_START, HVAC_LOG_INFO, "Start function probe") \
+    EVENT(HVAC_EV_PROBE_FUNCTION, HVAC_LOG_DEBUG, "Probe function %d answered: %d") \
+    EVENT(HVAC_EV_PROBE_DONE, HVAC_LOG_INFO, "Function probe done, %d function(s) not supported") \
+    EVENT(HVAC_EV_WRITE_UNSUPPORTED, HVAC_LOG_WARN, "%f not supported by unit, not written") \
+    EVENT(HVAC_EV_HEARTBEAT, HVAC_LOG_TRACE, "Heartbeat answered, rtt(ms): %d smoothed: %d") \
+    EVENT(HVAC_EV_HEARTBEAT_MISSED, HVAC_LOG_DEBUG, "Heartbeat not answered, %d missed in a row") \
+    EVENT(HVAC_EV_LINK_DOWN, HVAC_LOG_WARN, "Link down after %d missed heartbeats, try to send new handshake") \
+    EVENT(HVAC_EV_RX_CHECKSUM, HVAC_LOG_WARN, "Checksum error in packet type %d, not decoded") \
+    EVENT(HVAC_EV_RX_MALFORMED, HVAC_LOG_WARN, "Payload of packet type %d longer than packet, not decoded")
+
+#define HVAC_LOG_EVENT_ID(id, level, text) id,
+enum hvacLogEvent {
+    HVAC_LOG_EVENTS(HVAC_LOG_EVENT_ID)
+    HVAC_EV_COUNT
+};
+#undef HVAC_LOG_EVENT_ID
+
+#define HVAC_LOG_EVENT_LEVEL(id, level, text) level,
+static constexpr uint8_t HVAC_LOG_LEVEL[HVAC_EV_COUNT] = {HVAC_LOG_EVENTS(HVAC_LOG_EVENT_LEVEL)};
+#undef HVAC_LOG_EVENT_LEVEL
+
+// all texts in one string separated by \0, only searched when formatting
+#define HVAC_LOG_EVENT_TEXT(id, level, text) text "\0"
+static const char HVAC_LOG_TEXT[] HVAC_LOG_PROGMEM = HVAC_LOG_EVENTS(HVAC_LOG_EVENT_TEXT);
+#undef HVAC_LOG_EVENT_TEXT
+
+struct hvacLogRecord {
+    uint32_t time;      // micros
+    uint8_t event;
+    int16_t arg[3];
+};
+
+// level of event, constant folded when event is constant
+constexpr uint8_t hvacLogLevelOf(uint8_t event) {
+    return (event < HVAC_EV_COUNT) ? HVAC_LOG_LEVEL[event] : HVAC_LOG_ERROR;
+}
+
+// serialize record for binary dump, returns HVAC_LOG_RECORD_SIZE
+inline size_t hvacPackLogRecord(const hvacLogRecord* record, uint8_t data[]) {
+    for (uint8_t i=0; i<4; i++) data[i] = record->time >> (i * 8);
+    data[4] = record->event;
+    for (uint8_t i=0; i<3; i++) {
+        data[5 + (i * 2)] = (uint16_t)record->arg[i];
+        data[6 + (i * 2)] = (uint16_t)record->arg[i] >> 8;
+    }
+    return HVAC_LOG_RECORD_SIZE;
+}
+
+inline void hvacUnpackLogRecord(const uint8_t data[], hvacLogRecord* record) {
+    record->time = 0;
+    for (uint8_t i=0; i<4; i++) record->time |= (uint32_t)data[i] << (i * 8);
+    record->event = data[4];
+    for (uint8_t i=0; i<3; i++) record->arg[i] = (int16_t)(data[5 + (i * 2)] | (data[6 + (i * 2)] << 8));
+}
+
+// format record text (without time and level) into out, fieldNames resolve %f args
+inline size_t hvacFormatLogRecord(char out[], size_t size, const hvacLogRecord* record, const char* const fieldNames[], uint8_t fieldCount) {
+    size_t len = 0;
+    if (size == 0) return 0;
+    const char* text = HVAC_LOG_TEXT;
+    if (record->event >= HVAC_EV_COUNT) text = nullptr;
+    for (uint8_t event=0; text && (event < record->event); event++) {
+        while (HVAC_LOG_READ_BYTE(text)) text++;
+        text++;
+    }
+    uint8_t arg = 0;
+    char c;
+    while (text && (len < (size - 1)) && (c = HVAC_LOG_READ_BYTE(text++))) {
+        if ((c == '%') && ((HVAC_LOG_READ_BYTE(text) == 'd') || (HVAC_LOG_READ_BYTE(text) == 'f')) && (arg < 3)) {
+            int16_t value = record->arg[arg++];
+            if ((HVAC_LOG_READ_BYTE(text++) == 'f') && (value >= 0) && (value < fieldCount)) {
+                for (const char* name = fieldNames[value]; *name && (len < (size - 1)); name++) out[len++] = *name;
+                continue;
+            }
+            char digits[7];
+            uint8_t count = 0;
+            uint16_t number = (value < 0) ? -value : value;
+            do {
+                digits[count++] = '0' + (number % 10);
+                number /= 10;
+            } while (number);
+            if (value < 0) digits[count++] = '-';
+            while (count && (len < (size - 1))) out[len++] = digits[--count];
+        } else out[len++] = c;
+    }
+    if (!text) {    // event unknown to this version
+        const char unknown[] = "Unknown event";
+        for (uint8_t i=0; unknown[i] && (len < (size - 1)); i++) out[len++] = unknown[i];
+    }
+    out[len] = '\0';
+    return len;
+}
+
+inline const char* hvacLogLevelName(uint8_t level) {
+    static const char* const names[6] = {"NONE", "ERROR", "WARN", "INFO", "DEBUG", "TRACE"};
+    return (level < 6) ? names[level] : "?";
+}
+
+#endif // HvacLog_H
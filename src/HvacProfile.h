@@ -0,0 +1,101 @@
+#ifndef HvacProfile_H
+#define HvacProfile_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HVAC_PROFILE_BINS 8     // histogram bin n counts times below 16 << (2 * n) us, last bin counts all longer times
+
+// stage of handleHvac, time of nested stages is not counted in outer stage
+enum hvacProfileStage {
+    PROFILE_CALL,       // whole handleHvac call
+    PROFILE_RX,         // transport read and packet framing
+    PROFILE_DECODE,     // packet decode and state update
+    PROFILE_SYNC,       // handshake, queries, settings sync, writes, storage and history
+    PROFILE_CALLBACK,   // listener callbacks
+    PROFILE_TX,         // writing to transport
+    PROFILE_STAGES
+};
+
+struct hvacProfileStats {
+    uint32_t count;     // calls in which stage ran
+    uint32_t min;       // us per call
+    uint32_t max;
+    uint64_t total;     // avg = total / count
+    uint16_t histogram[HVAC_PROFILE_BINS];  // saturates at 65535
+};
+
+inline uint8_t hvacProfileBin(uint32_t time) {
+    uint8_t bin = 0;
+    for (uint32_t limit=16; (bin < (HVAC_PROFILE_BINS - 1)) && (time >= limit); limit <<= 2) bin++;
+    return bin;
+}
+
+inline const char* hvacProfileStageName(uint8_t stage) {
+    static const char* const names[PROFILE_STAGES] = {"CALL", "RX", "DECODE", "SYNC", "CALLBACK", "TX"};
+    return (stage < PROFILE_STAGES) ? names[stage] : "?";
+}
+
+// time per stage and handleHvac call, time is passed in by caller (micros)
+class HvacProfiler {
+    private:
+        hvacProfileStats _stats[PROFILE_STAGES] {};
+        uint32_t _spent[PROFILE_STAGES] {};     // of current call
+        uint8_t _ran = 0;                       // bit per stage entered in current call
+        uint8_t _stage = PROFILE_CALL;
+        uint32_t _start = 0;
+        uint32_t _mark = 0;
+        bool _active = false;
+
+        void record(uint8_t stage, uint32_t time) {
+            hvacProfileStats* stats = &_stats[stage];
+            if (!stats->count || (time < stats->min)) stats->min = time;
+            if (time > stats->max) stats->max = time;
+            stats->count++;
+            stats->total += time;
+            uint16_t* bin = &stats->histogram[hvacProfileBin(time)];
+            if (*bin < 0xFFFF) (*bin)++;
+        }
+
+    public:
+        void begin(uint32_t now) {
+            for (uint8_t i=0; i<PROFILE_STAGES; i++) _spent[i] = 0;
+            _ran = 1 << PROFILE_SYNC;
+            _stage = PROFILE_SYNC;
+            _start = _mark = now;
+            _active = true;
+        }
+
+        // switch current stage, returns previous stage to switch back
+        uint8_t enter(uint8_t stage, uint32_t now) {
+            uint8_t previous = _stage;
+            if (!_active) return previous;  // outside handleHvac
+            _spent[_stage] += now - _mark;
+            _mark = now;
+            _stage = stage;
+            _ran |= 1 << stage;
+            return previous;
+        }
+
+        void end(uint32_t now) {
+            if (!_active) return;
+            _spent[_stage] += now - _mark;
+            _active = false;
+            record(PROFILE_CALL, now - _start);
+            for (uint8_t i=PROFILE_RX; i<PROFILE_STAGES; i++) {
+                if (_ran & (1 << i)) record(i, _spent[i]);
+            }
+        }
+
+        bool get(uint8_t stage, hvacProfileStats* stats) const {
+            if (stage >= PROFILE_STAGES) return false;
+            *stats = _stats[stage];
+            return true;
+        }
+
+        void reset(void) {
+            for (uint8_t i=0; i<PROFILE_STAGES; i++) _stats[i] = hvacProfileStats {};
+        }
+};
+
+#endif // HvacProfile_H
@@ -0,0 +1,138 @@
+#ifndef HvacSchedule_H
+#define HvacSchedule_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HVAC_SECONDS_PER_DAY 86400UL
+#define HVAC_SECONDS_PER_WEEK 604800UL
+
+// days of schedule entry
+enum hvacScheduleDay {
+    SCHEDULE_MONDAY = 1,
+    SCHEDULE_TUESDAY = 2,
+    SCHEDULE_WEDNESDAY = 4,
+    SCHEDULE_THURSDAY = 8,
+    SCHEDULE_FRIDAY = 16,
+    SCHEDULE_SATURDAY = 32,
+    SCHEDULE_SUNDAY = 64,
+    SCHEDULE_WEEKDAYS = 31,
+    SCHEDULE_WEEKEND = 96,
+    SCHEDULE_EVERYDAY = 127
+};
+
+// local time source of schedule, implement secondOfWeek to use your own clock (RTC, GPS, fake clock in tests)
+class HvacClock {
+    public:
+        virtual bool secondOfWeek(uint32_t* second) = 0;    // seconds since Monday 00:00 local time, false when time is not known yet
+        virtual ~HvacClock() {}
+};
+
+#if !defined(__AVR__)
+#include <time.h>
+
+// system time, set by NTP (configTime() on ESP8266 and ESP32), local time zone from TZ
+class HvacSystemClock : public HvacClock {
+    public:
+        bool secondOfWeek(uint32_t* second) {
+            time_t now = time(nullptr);
+            if (now < 1600000000) return false;     // not synced yet
+            struct tm local;
+            localtime_r(&now, &local);
+            *second = (((local.tm_wday + 6) % 7) * HVAC_SECONDS_PER_DAY) + (local.tm_hour * 3600UL) + (local.tm_min * 60UL) + local.tm_sec;
+            return true;
+        }
+};
+#endif
+
+// schedule entry, settings are saved as protocol byte values (setpoint as number, wifi led as wifi led 1 value), 255 = not changed
+struct hvacScheduleEntry {
+    uint16_t minute;        // of day, 0-1439
+    uint8_t days;           // hvacScheduleDay bits, 0 = unused slot
+    uint8_t settings[9];    // state, setpoint, mode, swing, fanMode, pure, powerSelect, operation, wifiLed
+};
+
+// fixed-memory week schedule, every entry is due once per selected day
+template<uint8_t SIZE>
+class HvacSchedule {
+    private:
+        hvacScheduleEntry _entries[SIZE] {};
+
+        // seconds from "from" to next time entry is due, 1 to one week
+        uint32_t untilDue(const hvacScheduleEntry* entry, uint32_t from) const {
+            uint32_t best = HVAC_SECONDS_PER_WEEK;
+            for (uint8_t day=0; day<7; day++) {
+                if (!(entry->days & (1 << day))) continue;
+                uint32_t due = (day * HVAC_SECONDS_PER_DAY) + (entry->minute * 60UL);
+                uint32_t distance = (due + HVAC_SECONDS_PER_WEEK - from) % HVAC_SECONDS_PER_WEEK;
+                if (distance == 0) distance = HVAC_SECONDS_PER_WEEK;
+                if (distance < best) best = distance;
+            }
+            return best;
+        }
+
+    public:
+        uint8_t size(void) const { return SIZE; }
+        hvacScheduleEntry* entries(void) { return _entries; }
+
+        int8_t add(const hvacScheduleEntry* entry) {
+            if (!entry->days || (entry->minute >= 1440)) return -1;
+            for (uint8_t i=0; i<SIZE; i++) {
+                if (!_entries[i].days) {
+                    _entries[i] = *entry;
+                    _entries[i].days &= SCHEDULE_EVERYDAY;
+                    return i;
+                }
+            }
+            return -1;
+        }
+
+        bool remove(uint8_t slot) {
+            if ((slot >= SIZE) || !_entries[slot].days) return false;
+            _entries[slot] = hvacScheduleEntry {};
+            return true;
+        }
+
+        void clear(void) {
+            for (uint8_t i=0; i<SIZE; i++) _entries[i] = hvacScheduleEntry {};
+        }
+
+        bool get(uint8_t slot, hvacScheduleEntry* entry) const {
+            if ((slot >= SIZE) || !_entries[slot].days) return false;
+            *entry = _entries[slot];
+            return true;
+        }
+
+        // seconds until next entry is due after now, 0 when schedule is empty
+        uint32_t next(uint32_t now) const {
+            uint32_t best = 0;
+            for (uint8_t i=0; i<SIZE; i++) {
+                if (!_entries[i].days) continue;
+                uint32_t distance = untilDue(&_entries[i], now);
+                if (!best || (distance < best)) best = distance;
+            }
+            return best;
+        }
+
+        // slots due after "from" up to and including "to" (less than one day apart), in order they were due, returns count
+        uint8_t due(uint32_t from, uint32_t to, uint8_t slots[SIZE]) const {
+            uint32_t window = (to + HVAC_SECONDS_PER_WEEK - from) % HVAC_SECONDS_PER_WEEK;
+            uint32_t distance[SIZE];
+            uint8_t count = 0;
+            for (uint8_t i=0; i<SIZE; i++) {
+                if (!_entries[i].days) continue;
+                uint32_t d = untilDue(&_entries[i], from);
+                if (d > window) continue;
+                uint8_t j = count++;
+                for (; (j > 0) && (distance[j - 1] > d); j--) {     // insertion sort by time due
+                    distance[j] = distance[j - 1];
+                    slots[j] = slots[j - 1];
+                }
+                distance[j] = d;
+                slots[j] = i;
+            }
+            return count;
+        }
+};
+
+#endif // HvacSchedule_H
@@ -0,0 +1,79 @@
+#ifndef HvacStorage_H
+#define HvacStorage_H
+
+#include <stdint.h>
+
+// storage backend used to keep data over reboot, implement read and write to use your own storage
+class HvacStorage {
+    public:
+        virtual bool read(uint16_t address, uint8_t data[], uint16_t length) = 0;
+        virtual bool write(uint16_t address, const uint8_t data[], uint16_t length) = 0;   // should skip bytes that didn't change
+        virtual ~HvacStorage() {}
+};
+
+#if defined(ARDUINO) && (defined(__AVR__) || defined(ESP8266) || defined(ESP32))
+#include <EEPROM.h>
+
+// EEPROM (AVR) or emulated EEPROM in flash (ESP8266, ESP32 NVS), only changed bytes are written
+class HvacEepromStorage : public HvacStorage {
+    private:
+        uint16_t _size;
+        bool _begin = false;
+
+        void begin(void) {
+            #if defined(ESP8266) || defined(ESP32)
+            if (!_begin) EEPROM.begin(_size);
+            #endif
+            _begin = true;
+        }
+
+    public:
+        HvacEepromStorage(uint16_t size = 512) : _size(size) {}
+
+        bool read(uint16_t address, uint8_t data[], uint16_t length) {
+            if ((uint32_t)address + length > _size) return false;
+            begin();
+            for (uint16_t i=0; i<length; i++) data[i] = EEPROM.read(address + i);
+            return true;
+        }
+
+        bool write(uint16_t address, const uint8_t data[], uint16_t length) {
+            if ((uint32_t)address + length > _size) return false;
+            begin();
+            bool changed = false;
+            for (uint16_t i=0; i<length; i++) {
+                if (EEPROM.read(address + i) != data[i]) {
+                    EEPROM.write(address + i, data[i]);
+                    changed = true;
+                }
+            }
+            #if defined(ESP8266) || defined(ESP32)
+            if (changed) return EEPROM.commit();
+            #endif
+            return true;
+        }
+};
+#endif
+
+#if defined(ARDUINO) && defined(ESP8266)
+// ESP8266 RTC user memory (512 bytes), survive reset and deep sleep but not power loss, no wear
+class HvacRtcStorage : public HvacStorage {
+    public:
+        bool read(uint16_t address, uint8_t data[], uint16_t length) {
+            uint32_t block[(length + 3) / 4];
+            if ((address % 4) || !ESP.rtcUserMemoryRead(address / 4, block, sizeof(block))) return false;
+            memcpy(data, block, length);
+            return true;
+        }
+
+        bool write(uint16_t address, const uint8_t data[], uint16_t length) {
+            uint32_t block[(length + 3) / 4];
+            memset(block, 0, sizeof(block));
+            memcpy(block, data, length);
+            if (address % 4) return false;
+            return ESP.rtcUserMemoryWrite(address / 4, block, sizeof(block));
+        }
+};
+#endif
+
+#endif // HvacStorage_H
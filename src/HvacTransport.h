@@ -0,0 +1,120 @@
+#ifndef HvacTransport_H
+#define HvacTransport_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// transports for ToshibaCarrierHvacT, a transport needs available(), readBytes(), write() and availableForWrite() like HardwareSerial.
+// readBytes() is only called with bytes already available so it never waits.
+
+// in-memory pipe for tests and simulators, library side is available/readBytes/write, unit side is inject/drain
+template<uint16_t SIZE = 256>
+class HvacPipeTransport {
+    private:
+        struct ring {
+            uint8_t data[SIZE];
+            uint16_t head = 0;
+            uint16_t count = 0;
+
+            size_t push(const uint8_t bytes[], size_t length) {
+                if (length > (size_t)(SIZE - count)) length = SIZE - count;
+                for (size_t i=0; i<length; i++) data[(head + count + i) % SIZE] = bytes[i];
+                count += length;
+                return length;
+            }
+
+            size_t pop(uint8_t bytes[], size_t length) {
+                if (length > count) length = count;
+                for (size_t i=0; i<length; i++) bytes[i] = data[(head + i) % SIZE];
+                head = (head + length) % SIZE;
+                count -= length;
+                return length;
+            }
+        };
+        ring _rx;   // unit -> library
+        ring _tx;   // library -> unit
+
+    public:
+        int available(void) { return _rx.count; }
+        size_t readBytes(uint8_t data[], size_t length) { return _rx.pop(data, length); }
+        size_t write(const uint8_t data[], size_t length) { return _tx.push(data, length); }
+        int availableForWrite(void) { return SIZE - _tx.count; }
+
+        size_t inject(const uint8_t data[], size_t length) { return _rx.push(data, length); }  // bytes sent by unit
+        size_t drain(uint8_t data[], size_t length) { return _tx.pop(data, length); }          // bytes sent by library
+        uint16_t pending(void) { return _tx.count; }
+};
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+#define HVAC_FD_TX_QUEUE 256    // bytes queued in tty before write waits for transport
+
+// set tty to raw 9600 8E1 without flow control, reads return at once (VMIN 0, VTIME 0), bytes with parity error are dropped
+inline bool hvacConfigureSerial(int fd) {
+    struct termios tty;
+    if (tcgetattr(fd, &tty) < 0) return false;
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, B9600);
+    cfsetospeed(&tty, B9600);
+    tty.c_cflag &= ~(CSIZE | PARODD | CSTOPB | CRTSCTS);
+    tty.c_cflag |= CS8 | PARENB | CLOCAL | CREAD;
+    tty.c_iflag &= ~(IXON | IXOFF | IXANY);
+    tty.c_iflag |= INPCK | IGNPAR;
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &tty) < 0) return false;
+    tcflush(fd, TCIOFLUSH);
+    return true;
+}
+
+// open serial port (e.g. /dev/ttyUSB0) non-blocking at 9600 8E1 for HvacFdTransport, returns fd or -1
+inline int hvacOpenSerial(const char* path) {
+    int fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return -1;
+    if (!hvacConfigureSerial(fd)) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// file descriptor of an opened and configured (9600 8E1) serial port, pipe or socket
+class HvacFdTransport {
+    private:
+        int _fd;
+
+    public:
+        HvacFdTransport(int fd) : _fd(fd) {}
+
+        int fd(void) { return _fd; }
+
+        int available(void) {
+            int count = 0;
+            if (ioctl(_fd, FIONREAD, &count) < 0) return 0;
+            return count;
+        }
+
+        size_t readBytes(uint8_t data[], size_t length) {
+            ssize_t count = ::read(_fd, data, length);
+            return count > 0 ? count : 0;
+        }
+
+        size_t write(const uint8_t data[], size_t length) {
+            ssize_t count = ::write(_fd, data, length);
+            return count > 0 ? count : 0;
+        }
+
+        int availableForWrite(void) {
+            int queued = 0;
+            if (ioctl(_fd, TIOCOUTQ, &queued) < 0) queued = 0;  // not a tty, write takes what it can
+            return (queued < HVAC_FD_TX_QUEUE) ? (HVAC_FD_TX_QUEUE - queued) : 0;
+        }
+};
+#endif
+
+#endif // HvacTransport_H
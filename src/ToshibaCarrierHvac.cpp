@@ -1,33 +1,49 @@
 #include "ToshibaCarrierHvac.h"
 
 #define BUADRATE 9600                       // buadrate
-#define MAX_RX_BYTE_READ 250                // max bytes read
-#define RX_READ_TIMEOUT 250                 // read timeout(ms)
+#define MAX_RX_BYTE_READ 250                // rx buffer size of hardware serial (ESP)
+#define RX_READ_TIMEOUT 250                 // drop incomplete packet when no more data received within x ms
+#define POLL_MIN_INTERVAL 15                // min interval(seconds) between temperature queries while temperature is changing or CDU is starting
+#define POLL_MAX_INTERVAL 180               // max interval(seconds) between temperature queries when unit is off and stable
 #define IDLE_TIMEOUT 1                      // max timeout(minutes) after received data, try to query temperature to check the connection (should not exceed than 3 minutes)
+#define CDU_START_WINDOW 300                // keep polling at min interval for x seconds after CDU started
 #define CONNECTION_TIMEOUT 2                // max timeout(minutes) after sent some query or command but no reply in time, that's mean connection break or disconnected, try to send new handshake
 #define START_DELAY 10                      // after connected delay x second before query all data
-#define SETTINGS_SEND_DELAY 600             // delay x ms before send next setting (do not decrease too much, your hvac may not parse a setting correctly)
+#define CACHE_WRITE_DELAY 60                // check and save changed settings to storage every x second(s), status only changes are not saved to reduce wear
+#define WRITE_CONFIRM_TIMEOUT 10            // write failed when not confirmed by the unit within x second(s) plus settings delay for each function
+#define CACHE_MAGIC 0xA2                    // change when cache structure changed
+#define SCHEDULE_MAGIC 0xB2                 // change when schedule entry structure or offset changed
+#define SCHEDULE_MAX_SLEEP 900              // check clock at least every x seconds while waiting for next schedule entry (clock sync, daylight saving)
+#define SCHEDULE_MAX_LATE 1200              // entries missed for longer than x seconds (clock jump, long blocking) are skipped
+#define SCHEDULE_CLOCK_RETRY 10             // check clock again after x seconds when time is not known yet
+#define SETTINGS_SEND_DELAY 600             // default delay x ms before send next setting (do not decrease too much, your hvac may not parse a setting correctly)
+#define SETTINGS_COALESCE_DELAY 300         // send a setting after it was not changed for x ms, only the latest value is sent (slider, repeated automation calls)
+#define MAX_COMMANDS_PER_MINUTE 30          // default limit of setting commands sent per minute, 0 = no limit
+#define COMMAND_BURST 5                     // setting commands sent at once before rate limit applies
+#define QUERY_SEND_DELAY 200                // default delay x ms before send next query
+#define QUERY_REPLY_TIMEOUT 1000            // pipelined query is sent again when not answered within x ms
+#define QUERY_MAX_RETRIES 2                 // pipelined query is dropped after x retries
+#define CALIBRATE_MIN_DELAY 20              // shortest delay(ms) tried by pacing calibration
+#define CALIBRATE_REPLY_TIMEOUT 1000        // wait for reply(ms) during pacing calibration
+#define CALIBRATE_QUERY_PROBES 4            // query delays tried by binary search of pacing calibration
+#define CALIBRATE_SETTINGS_PROBES 2         // settings delays tried, each probe writes current setpoint twice (unit beeps)
+#define CALIBRATE_MARGIN 25                 // add x percent to the shortest working delay found by pacing calibration
 #define SINGLE_QUEUE_TIMEOUT 800            // when timeout(ms) reached and has only one callback in queue just do a callback
 #define MULTI_QUEUE_TIMEOUT 1500            // when queue > 1, wait for other data until timeout(ms) then do a callback
+#define HISTORY_MAX_CATCHUP 86400          // max seconds sampled at once into history when handleHvac wasn't called for a long time
+#define HEARTBEAT_INTERVAL 0                // default idle time(ms) before heartbeat query, 0 = off (link loss found by poll and CONNECTION_TIMEOUT only)
+#define HEARTBEAT_FUNCTION 128              // function queried as heartbeat, state is answered by every model
+#define HEARTBEAT_MIN_TIMEOUT 300           // heartbeat is missed when not answered within smoothed rtt + 4 deviations, at least x ms
 #define MAX_FEEDBACK_COUNT 5                // when received x feedbacks then query temperature once to avoid front panel blinking, this value should not exceed 20.
 
-extern HardwareSerial Serial;
-#if defined(HVAC_USE_SW_SERIAL)
-ToshibaCarrierHvac::ToshibaCarrierHvac(uint8_t rxPin, uint8_t txPin) {
-    #if defined(__AVR__)
-    CustomSoftwareSerial *port = new CustomSoftwareSerial(rxPin, txPin);
-    port->begin(BUADRATE, CSERIAL_8E1);
-    #endif
-    #if defined(ESP8266)
-    SoftwareSerial *port = new SoftwareSerial(rxPin, txPin);
-    port->begin(BUADRATE, SWSERIAL_8E1);
-    #endif
-    this->_serial = port;
-    this->_swSerial = true;
-}
+// log record, compiled only with HVAC_DEBUG, args are converted to int16_t
+#if defined(HVAC_DEBUG)
+    #define HVAC_LOG(event, ...) do { if (hvacLogLevelOf(event) <= _logLevel) writeLog(event, ##__VA_ARGS__); } while (0)
+#else
+    #define HVAC_LOG(event, ...) do {} while (0)
 #endif
 
-ToshibaCarrierHvac::ToshibaCarrierHvac(HardwareSerial* port) {
+void hvacBeginTransport(HardwareSerial* port) {
     #if defined(ESP8266) || defined(ESP32)
     port->setRxBufferSize(MAX_RX_BYTE_READ);
     #endif
@@ -35,60 +51,99 @@ ToshibaCarrierHvac::ToshibaCarrierHvac(HardwareSerial* port) {
     #if defined(ESP8266)
     // port->swap();
     #endif
-    this->_serial = port;
-    this->_swSerial = false;
 }
 
-ToshibaCarrierHvac::~ToshibaCarrierHvac() {
-    if (_swSerial) delete this->_serial;
+#if defined(HVAC_USE_SW_SERIAL)
+void hvacBeginTransport(HvacSoftwareSerial* port) {
+    #if defined(__AVR__)
+    port->begin(BUADRATE, CSERIAL_8E1);
+    #endif
+    #if defined(ESP8266)
+    port->begin(BUADRATE, SWSERIAL_8E1);
+    #endif
 }
+#endif
 
-// callback
-void ToshibaCarrierHvac::setStatusUpdatedCallback(STATUS_UPDATED_CALLBACK_SIGNATURE) {
-    this->statusUpdatedCallback = statusUpdatedCallback;
+ToshibaCarrierHvacCore::ToshibaCarrierHvacCore(void) {
+    this->_pacing = {QUERY_SEND_DELAY, SETTINGS_SEND_DELAY, 0};
+    this->_pollMinInterval = POLL_MIN_INTERVAL * 1000UL;
+    this->_pollMaxInterval = POLL_MAX_INTERVAL * 1000UL;
+    this->_coalesceDelay = SETTINGS_COALESCE_DELAY;
+    setCommandRate(MAX_COMMANDS_PER_MINUTE);
+    setHeartbeat(HEARTBEAT_INTERVAL);
 }
-void ToshibaCarrierHvac::setSettingsUpdatedCallback(SETTINGS_UPDATED_CALLBACK_SIGNATURE) {
-    this->settingsUpdatedCallback = settingsUpdatedCallback;
-}
-void ToshibaCarrierHvac::setUpdateCallback(UPDATE_CALLBACK_SIGNATURE) {
-    this->updateCallback = updateCallback;
+
+// prebuilt packets
+constexpr byte ToshibaCarrierHvacCore::HANDSHAKE_SYN_PACKET_1[8] HVAC_PROGMEM;
+constexpr byte ToshibaCarrierHvacCore::HANDSHAKE_SYN_PACKET_2[9] HVAC_PROGMEM;
+constexpr byte ToshibaCarrierHvacCore::HANDSHAKE_SYN_PACKET_3[10] HVAC_PROGMEM;
+constexpr byte ToshibaCarrierHvacCore::HANDSHAKE_SYN_PACKET_4[10] HVAC_PROGMEM;
+constexpr byte ToshibaCarrierHvacCore::HANDSHAKE_SYN_PACKET_5[10] HVAC_PROGMEM;
+constexpr byte ToshibaCarrierHvacCore::HANDSHAKE_SYN_PACKET_6[8] HVAC_PROGMEM;
+constexpr byte ToshibaCarrierHvacCore::HANDSHAKE_ACK_PACKET_1[10] HVAC_PROGMEM;
+constexpr byte ToshibaCarrierHvacCore::HANDSHAKE_ACK_PACKET_2[10] HVAC_PROGMEM;
+constexpr byte ToshibaCarrierHvacCore::QUERY_PACKET[15][14] HVAC_PROGMEM;
+
+// write handle
+hvacWriteState HvacWrite::state(void) const {
+    if (!_hvac || (_hvac->_writes[_slot].seq != _seq)) return WRITE_INVALID;
+    return (hvacWriteState)_hvac->_writes[_slot].state;
 }
-void ToshibaCarrierHvac::setWhichFunctionUpdatedCallback(WHICH_FUNCTION_UPDATED_CALLBACK_SIGNATURE) {
-    this->whichFunctionUpdatedCallback = whichFunctionUpdatedCallback;
+
+uint16_t HvacWrite::latency(void) const {
+    if (state() != WRITE_DONE) return 0;
+    return _hvac->_writes[_slot].latency;
 }
 
 // normal function
-void ToshibaCarrierHvac::sendPacket(byte data[], size_t dataLen) {
-    _serial->write(data, dataLen);
+bool ToshibaCarrierHvacCore::sendPacket(const byte data[], size_t dataLen, bool flash) {
+    if (_listenOnly) {
+        HVAC_LOG(HVAC_EV_TX_LISTEN_ONLY, dataLen);
+        return false;
+    }
+    if (dataLen > (size_t)(TX_BUFFER_SIZE - _txLen)) {   // never send part of packet
+        HVAC_LOG(HVAC_EV_TX_FULL, dataLen);
+        return false;
+    }
+    #if defined(HVAC_DEBUG)
+    uint8_t start = _txHead + _txLen;   // only logged
+    #endif
+    for (uint8_t i=0; i<dataLen; i++) {
+        byte c = flash ? HVAC_READ_PACKET_BYTE(data + i) : data[i];
+        _txBuffer[(_txHead + _txLen++) % TX_BUFFER_SIZE] = c;
+    }
+    HVAC_LOG(HVAC_EV_TX, dataLen, _txBuffer[(start + 3) % TX_BUFFER_SIZE], (dataLen > 13) ? _txBuffer[(start + 12) % TX_BUFFER_SIZE] : -1);
     _lastSendWake = millis();
     _sendWake = true;
-    #ifdef HVAC_DEBUG
-    DEBUG_PORT.print(F("HVAC> Sending data-> "));
-    char temp[dataLen];
-    for (uint8_t i=0; i<dataLen; i++) {
-        DEBUG_PORT.print(data[i]);
-        DEBUG_PORT.print(" ");
+    flushTx();
+    return true;
+}
+
+bool ToshibaCarrierHvacCore::sendQuery(byte function) {
+    for (uint8_t i=0; i<(sizeof(QUERY_PACKET) / sizeof(QUERY_PACKET[0])); i++) {
+        if (HVAC_READ_PACKET_BYTE(&QUERY_PACKET[i][12]) == function) return sendPacket(QUERY_PACKET[i], sizeof(QUERY_PACKET[i]), true);
     }
-    DEBUG_PORT.println("");
-    #endif
+    byte data[1] = {function};
+    return createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, 1);
 }
 
-void ToshibaCarrierHvac::sendPacket(const byte data[], size_t dataLen) {
-    _serial->write(data, dataLen);
-    _lastSendWake = millis();
-    _sendWake = true;
-    #ifdef HVAC_DEBUG
-    DEBUG_PORT.print(F("HVAC> Sending data-> "));
-    char temp[dataLen];
-    for (uint8_t i=0; i<dataLen; i++) {
-        DEBUG_PORT.print(data[i]);
-        DEBUG_PORT.print(" ");
+void ToshibaCarrierHvacCore::flushTx(void) {
+    if (!_txLen) return;
+    HVAC_PROFILE_SCOPE(PROFILE_TX);
+    while (_txLen) {    // write only what transport can take without waiting
+        int space = writableTransport();
+        if (space <= 0) return;
+        uint8_t len = _txLen;
+        if (len > (TX_BUFFER_SIZE - _txHead)) len = TX_BUFFER_SIZE - _txHead;  // until end of ring
+        if (len > space) len = space;
+        size_t sent = writeTransport(_txBuffer + _txHead, len);
+        if (!sent) return;
+        _txHead = (_txHead + sent) % TX_BUFFER_SIZE;
+        _txLen -= sent;
     }
-    DEBUG_PORT.println("");
-    #endif
 }
 
-byte ToshibaCarrierHvac::getByteByName(const byte byteMap[], const char* valMap[], size_t byteLen, const char* name) {
+byte ToshibaCarrierHvacCore::getByteByName(const byte byteMap[], const char* valMap[], size_t byteLen, const char* name) {
     yield();
     for (uint8_t i=0; i<byteLen; i++) {
         if(strcasecmp(valMap[i], name) == 0) {
@@ -98,7 +153,7 @@ byte ToshibaCarrierHvac::getByteByName(const byte byteMap[], const char* valMap[
     return 255;
 }
 
-const char* ToshibaCarrierHvac::getNameByByte(const char* valMap[], const byte byteMap[], size_t byteLen, byte byteVal) {
+const char* ToshibaCarrierHvacCore::getNameByByte(const char* valMap[], const byte byteMap[], size_t byteLen, byte byteVal) {
     yield();
     for (uint8_t i=0; i<byteLen; i++) {
         if (byteMap[i] == byteVal) {
@@ -108,7 +163,7 @@ const char* ToshibaCarrierHvac::getNameByByte(const char* valMap[], const byte b
     return valMap[byteLen];
 }
 
-byte ToshibaCarrierHvac::checksum(uint16_t baseKey, byte data[], size_t dataLen) {
+byte ToshibaCarrierHvacCore::checksum(uint16_t baseKey, byte data[], size_t dataLen) {
     int16_t result=0;
     uint16_t key = baseKey - (dataLen * 2);
     result = key;
@@ -120,12 +175,12 @@ byte ToshibaCarrierHvac::checksum(uint16_t baseKey, byte data[], size_t dataLen)
     else return result;
 }
 
-int8_t ToshibaCarrierHvac::temperatureCorrection(byte val) {
+int8_t ToshibaCarrierHvacCore::temperatureCorrection(byte val) {
     if (val > 127) return ((256 - val) * (-1));
     else return val;
 }
 
-bool ToshibaCarrierHvac::createPacket(const byte header[], size_t headerLen, byte packetType, byte data[],byte dataLen) {
+bool ToshibaCarrierHvacCore::createPacket(const byte header[], size_t headerLen, byte packetType, byte data[],byte dataLen) {
     if (packetType == getByteByName(PACKET_TYPE, PACKET_TYPE_MAP, sizeof(PACKET_TYPE), "COMMAND")) {    // type: command
         byte packet[12 + dataLen + 1];    // base + dataLen + checksum
         memset(packet, 0, sizeof(packet));  // set all index to 0
@@ -140,13 +195,9 @@ bool ToshibaCarrierHvac::createPacket(const byte header[], size_t headerLen, byt
         memcpy(packet + 12, data, dataLen);   // add data
         packet[sizeof(packet) - 1] = checksum(438, data, dataLen);  // add checksum
 
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.println(F("HVAC> Command/Query packet was created"));
-        #endif
 
         // send created packet
-        sendPacket(packet, sizeof(packet));
-        return true;
+        return sendPacket(packet, sizeof(packet));
     } else if (packetType == getByteByName(PACKET_TYPE, PACKET_TYPE_MAP, sizeof(PACKET_TYPE), "REPLY")) {     // type: reply
         byte packet[14 + dataLen + 1];    // base + dataLen + checksum
         memset(packet, 0, sizeof(packet));  // set all index to 0
@@ -161,1239 +212,2017 @@ bool ToshibaCarrierHvac::createPacket(const byte header[], size_t headerLen, byt
         memcpy(packet + 14, data, dataLen);   // add data
         packet[sizeof(packet) - 1] = checksum(308, data, dataLen);  // add checksum
 
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.println(F("HVAC> Reply packet was created"));
-        #endif
 
         // send created packet
-        sendPacket(packet, sizeof(packet));
-        return true;
+        return sendPacket(packet, sizeof(packet));
     }
     return false;
 }
 
-void ToshibaCarrierHvac::sendHandshake(void) {
-    if (_firstRun && !_connected) { // send first handshake
-        sendPacket(HANDSHAKE_SYN_PACKET_1, sizeof(HANDSHAKE_SYN_PACKET_1));
-        delay(200);
-        sendPacket(HANDSHAKE_SYN_PACKET_2, sizeof(HANDSHAKE_SYN_PACKET_2));
-        delay(200);
-        sendPacket(HANDSHAKE_SYN_PACKET_3, sizeof(HANDSHAKE_SYN_PACKET_3));
-        delay(200);
-        sendPacket(HANDSHAKE_SYN_PACKET_4, sizeof(HANDSHAKE_SYN_PACKET_4));
-        delay(200);
-        sendPacket(HANDSHAKE_SYN_PACKET_5, sizeof(HANDSHAKE_SYN_PACKET_5));
-        delay(200);
-        sendPacket(HANDSHAKE_SYN_PACKET_6, sizeof(HANDSHAKE_SYN_PACKET_6));
-        delay(200);
-        _sendWake = true;
-        _lastSendWake = millis();
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.println(F("HVAC> First handshake sent. Waiting for SYN/ACK packet"));
-        #endif
-    } else if (_handshake && !_connected && !_ready) {  // when received syn/ack then send ack
-        sendPacket(HANDSHAKE_ACK_PACKET_1, sizeof(HANDSHAKE_ACK_PACKET_1));
-        delay(200);
-        sendPacket(HANDSHAKE_ACK_PACKET_2, sizeof(HANDSHAKE_ACK_PACKET_2));
-        delay(100);
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.println(F("HVAC> Waiting for ready feedback"));
-        #endif
-        _handshake = false;
-        _ready = _sendWake = true;
-        _lastSendWake = millis();
+// SYN 1-6 on first run, ACK 1-2 after SYN/ACK received. Blocking without time budget, one packet per call when its delay passed with time budget
+void ToshibaCarrierHvacCore::sendHandshake(void) {
+    if (!_handshakeStep) {
+        if (_firstRun && !_connected) _handshakeStep = 1;   // send first handshake
+        else if (_handshake && !_connected && !_ready) _handshakeStep = 8;  // when received syn/ack then send ack
+        else return;
+        _handshakeWait = 0;
+    }
+    while (_handshakeStep) {
+        if ((millis() - _lastHandshakeStep) < _handshakeWait) {
+            if (_budget) return;    // continue on next call
+            delay(_handshakeWait - (millis() - _lastHandshakeStep));
+        }
+        _lastHandshakeStep = millis();
+        _handshakeWait = 200;
+        switch (_handshakeStep++) {
+            case 1: sendPacket(HANDSHAKE_SYN_PACKET_1, sizeof(HANDSHAKE_SYN_PACKET_1), true); break;
+            case 2: sendPacket(HANDSHAKE_SYN_PACKET_2, sizeof(HANDSHAKE_SYN_PACKET_2), true); break;
+            case 3: sendPacket(HANDSHAKE_SYN_PACKET_3, sizeof(HANDSHAKE_SYN_PACKET_3), true); break;
+            case 4: sendPacket(HANDSHAKE_SYN_PACKET_4, sizeof(HANDSHAKE_SYN_PACKET_4), true); break;
+            case 5: sendPacket(HANDSHAKE_SYN_PACKET_5, sizeof(HANDSHAKE_SYN_PACKET_5), true); break;
+            case 6: sendPacket(HANDSHAKE_SYN_PACKET_6, sizeof(HANDSHAKE_SYN_PACKET_6), true); break;
+            case 7:
+                _handshakeStep = 0;
+                _sendWake = true;
+                _lastSendWake = millis();
+                HVAC_LOG(HVAC_EV_HANDSHAKE);
+                break;
+            case 8: sendPacket(HANDSHAKE_ACK_PACKET_1, sizeof(HANDSHAKE_ACK_PACKET_1), true); break;
+            case 9:
+                sendPacket(HANDSHAKE_ACK_PACKET_2, sizeof(HANDSHAKE_ACK_PACKET_2), true);
+                _handshakeWait = 100;
+                break;
+            default:
+                _handshakeStep = 0;
+                HVAC_LOG(HVAC_EV_WAIT_READY);
+                _handshake = false;
+                _ready = _sendWake = true;
+                _lastSendWake = millis();
+                break;
+        }
     }
 }
 
-bool ToshibaCarrierHvac::syncUserSettings(void) {
-    if (strcasecmp(wantedSettings.state, userSettings.state) != 0) {    // state
-        wantedSettings.state = userSettings.state;
+bool ToshibaCarrierHvacCore::syncUserSettings(uint16_t ready) {
+    if ((ready & (1 << FIELD_STATE)) && strcasecmp(wantedSettings.state, userSettings.state) != 0) {    // state
         byte data[2];
         data[0] = getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "STATE");
-        data[1] = getByteByName(STATE_BYTE, OFF_ON_MAP, sizeof(STATE_BYTE), wantedSettings.state);
-        createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data));
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.print(F("HVAC> User wanted State-> "));
-        DEBUG_PORT.println(wantedSettings.state);
-        #endif
+        data[1] = getByteByName(STATE_BYTE, OFF_ON_MAP, sizeof(STATE_BYTE), userSettings.state);
+        if (!createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data))) return false;    // TX ring full or listen only, sent on a later call
+        wantedSettings.state = userSettings.state;
+        HVAC_LOG(HVAC_EV_USER_SETTING, FIELD_STATE, data[1]);
+        _unsentFields &= ~(1 << FIELD_STATE);
         _lastSyncSettings = millis();
         return true;
     }
-    if (wantedSettings.setpoint != userSettings.setpoint) {    // setpoint
+    if ((ready & (1 << FIELD_SETPOINT)) && wantedSettings.setpoint != userSettings.setpoint) {    // setpoint
         if ((userSettings.setpoint >= 17) && (userSettings.setpoint <= 30)) {
-            wantedSettings.setpoint = userSettings.setpoint;
             byte data[2];
             data[0] = getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "SETPOINT");
-            data[1] = wantedSettings.setpoint;
-            createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data));
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.print(F("HVAC> User wanted Setpoint-> "));
-            DEBUG_PORT.println(wantedSettings.setpoint);
-            #endif
+            data[1] = userSettings.setpoint;
+            if (!createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data))) return false;
+            wantedSettings.setpoint = userSettings.setpoint;
+            HVAC_LOG(HVAC_EV_USER_SETTING, FIELD_SETPOINT, data[1]);
+            _unsentFields &= ~(1 << FIELD_SETPOINT);
             _lastSyncSettings = millis();
             return true;
         } else if (userSettings.setpoint < 17) {    // if value lower then minimun set to minimun
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.print(F("HVAC> error: User wanted out of range, set to minimum - User wanted Setpoint-> "));
-            DEBUG_PORT.println(userSettings.setpoint);
-            #endif
+            HVAC_LOG(HVAC_EV_SETPOINT_RANGE, userSettings.setpoint, 17);
             userSettings.setpoint = 17;
             return false;
         } else if (userSettings.setpoint > 30) {    // if value higher then maximun set to maximum
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.print(F("HVAC> error: User wanted out of range, set to maximum - User wanted Setpoint-> "));
-            DEBUG_PORT.println(userSettings.setpoint);
-            #endif
+            HVAC_LOG(HVAC_EV_SETPOINT_RANGE, userSettings.setpoint, 30);
             userSettings.setpoint = 30;
             return false;
         }
     }
-    if (strcasecmp(wantedSettings.mode, userSettings.mode) != 0) {    // mode
-        wantedSettings.mode = userSettings.mode;
+    if ((ready & (1 << FIELD_MODE)) && strcasecmp(wantedSettings.mode, userSettings.mode) != 0) {    // mode
         byte data[2];
         data[0] = getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "MODE");
-        data[1] = getByteByName(MODE_BYTE, MODE_BYTE_MAP, sizeof(MODE_BYTE), wantedSettings.mode);
-        createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data));
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.print(F("HVAC> User wanted Mode-> "));
-        DEBUG_PORT.println(wantedSettings.mode);
-        #endif
+        data[1] = getByteByName(MODE_BYTE, MODE_BYTE_MAP, sizeof(MODE_BYTE), userSettings.mode);
+        if (!createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data))) return false;
+        wantedSettings.mode = userSettings.mode;
+        HVAC_LOG(HVAC_EV_USER_SETTING, FIELD_MODE, data[1]);
+        _unsentFields &= ~(1 << FIELD_MODE);
         _lastSyncSettings = millis();
         return true;
     }
-    if (strcasecmp(wantedSettings.swing, userSettings.swing) != 0) {    // swing
-        wantedSettings.swing = userSettings.swing;
+    #if HVAC_FEATURES & HVAC_FEATURE_SWING
+    if ((ready & (1 << FIELD_SWING)) && strcasecmp(wantedSettings.swing, userSettings.swing) != 0) {    // swing
         byte data[2];
         data[0] = getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "SWING");
-        data[1] = getByteByName(SWING_BYTE, SWING_BYTE_MAP, sizeof(SWING_BYTE), wantedSettings.swing);
-        createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data));
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.print(F("HVAC> User wanted Swing-> "));
-        DEBUG_PORT.println(wantedSettings.swing);
-        #endif
+        data[1] = getByteByName(SWING_BYTE, SWING_BYTE_MAP, sizeof(SWING_BYTE), userSettings.swing);
+        if (!createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data))) return false;
+        wantedSettings.swing = userSettings.swing;
+        HVAC_LOG(HVAC_EV_USER_SETTING, FIELD_SWING, data[1]);
+        _unsentFields &= ~(1 << FIELD_SWING);
         _lastSyncSettings = millis();
         return true;
     }
-    if (strcasecmp(wantedSettings.fanMode, userSettings.fanMode) != 0) {    // fan mode
-        wantedSettings.fanMode = userSettings.fanMode;
+    #endif
+    if ((ready & (1 << FIELD_FANMODE)) && strcasecmp(wantedSettings.fanMode, userSettings.fanMode) != 0) {    // fan mode
         byte data[2];
         data[0] = getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "FANMODE");
-        data[1] = getByteByName(FANMODE_BYTE, FANMODE_BYTE_MAP, sizeof(FANMODE_BYTE), wantedSettings.fanMode);
-        createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data));
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.print(F("HVAC> User wanted FanMode-> "));
-        DEBUG_PORT.println(wantedSettings.fanMode);
-        #endif
+        data[1] = getByteByName(FANMODE_BYTE, FANMODE_BYTE_MAP, sizeof(FANMODE_BYTE), userSettings.fanMode);
+        if (!createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data))) return false;
+        wantedSettings.fanMode = userSettings.fanMode;
+        HVAC_LOG(HVAC_EV_USER_SETTING, FIELD_FANMODE, data[1]);
+        _unsentFields &= ~(1 << FIELD_FANMODE);
         _lastSyncSettings = millis();
         return true;
     }
-    if (strcasecmp(wantedSettings.pure, userSettings.pure) != 0) {    // pure
-        wantedSettings.pure = userSettings.pure;
+    #if HVAC_FEATURES & HVAC_FEATURE_PURE
+    if ((ready & (1 << FIELD_PURE)) && strcasecmp(wantedSettings.pure, userSettings.pure) != 0) {    // pure
         byte data[2];
         data[0] = getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "PURE");
-        data[1] = getByteByName(PURE_BYTE, OFF_ON_MAP, sizeof(PURE_BYTE), wantedSettings.pure);
-        createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data));
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.print(F("HVAC> User wanted Pure-> "));
-        DEBUG_PORT.println(wantedSettings.pure);
-        #endif
+        data[1] = getByteByName(PURE_BYTE, OFF_ON_MAP, sizeof(PURE_BYTE), userSettings.pure);
+        if (!createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data))) return false;
+        wantedSettings.pure = userSettings.pure;
+        HVAC_LOG(HVAC_EV_USER_SETTING, FIELD_PURE, data[1]);
+        _unsentFields &= ~(1 << FIELD_PURE);
         _lastSyncSettings = millis();
         return true;
     }
-    if (strcasecmp(wantedSettings.powerSelect, userSettings.powerSelect) != 0) {    // power select
-        wantedSettings.powerSelect = userSettings.powerSelect;
+    #endif
+    #if HVAC_FEATURES & HVAC_FEATURE_PSEL
+    if ((ready & (1 << FIELD_PSEL)) && strcasecmp(wantedSettings.powerSelect, userSettings.powerSelect) != 0) {    // power select
         byte data[2];
         data[0] = getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "PSEL");
-        data[1] = getByteByName(PSEL_BYTE, PSEL_BYTE_MAP, sizeof(PSEL_BYTE), wantedSettings.powerSelect);
-        createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data));
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.print(F("HVAC> User wanted PowerSelect-> "));
-        DEBUG_PORT.println(wantedSettings.powerSelect);
-        #endif
+        data[1] = getByteByName(PSEL_BYTE, PSEL_BYTE_MAP, sizeof(PSEL_BYTE), userSettings.powerSelect);
+        if (!createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data))) return false;
+        wantedSettings.powerSelect = userSettings.powerSelect;
+        HVAC_LOG(HVAC_EV_USER_SETTING, FIELD_PSEL, data[1]);
+        _unsentFields &= ~(1 << FIELD_PSEL);
         _lastSyncSettings = millis();
         return true;
     }
-    if (strcasecmp(wantedSettings.operation, userSettings.operation) != 0) {    // operation
-        wantedSettings.operation = userSettings.operation;
+    #endif
+    #if HVAC_FEATURES & HVAC_FEATURE_OP
+    if ((ready & (1 << FIELD_OP)) && strcasecmp(wantedSettings.operation, userSettings.operation) != 0) {    // operation
         byte data[2];
         data[0] = getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "OP");
-        data[1] = getByteByName(OP_BYTE, OP_BYTE_MAP, sizeof(OP_BYTE), wantedSettings.operation);
-        createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data));
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.print(F("HVAC> User wanted Operation-> "));
-        DEBUG_PORT.println(wantedSettings.operation);
-        #endif
+        data[1] = getByteByName(OP_BYTE, OP_BYTE_MAP, sizeof(OP_BYTE), userSettings.operation);
+        if (!createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data))) return false;
+        wantedSettings.operation = userSettings.operation;
+        HVAC_LOG(HVAC_EV_USER_SETTING, FIELD_OP, data[1]);
+        _unsentFields &= ~(1 << FIELD_OP);
         _lastSyncSettings = millis();
         return true;
     }
-    if (strcasecmp(wantedSettings.wifiLed, userSettings.wifiLed) != 0) {    // wifi led
-        wantedSettings.wifiLed = userSettings.wifiLed;
+    #endif
+    #if HVAC_FEATURES & HVAC_FEATURE_WIFILED
+    if ((ready & (1 << FIELD_WIFILED)) && strcasecmp(wantedSettings.wifiLed, userSettings.wifiLed) != 0) {    // wifi led
         byte data[2];
         if (!_wifiled) {    // wifi led 1
             data[0] = getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "WIFILED1");
-            data[1] = getByteByName(WIFILED1_BYTE, OFF_ON_MAP, sizeof(WIFILED1_BYTE), wantedSettings.wifiLed);
+            data[1] = getByteByName(WIFILED1_BYTE, OFF_ON_MAP, sizeof(WIFILED1_BYTE), userSettings.wifiLed);
         } else {    // wifi led 2
             data[0] = getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "WIFILED2");
-            data[1] = getByteByName(WIFILED2_BYTE, OFF_ON_MAP, sizeof(WIFILED2_BYTE), wantedSettings.wifiLed);
+            data[1] = getByteByName(WIFILED2_BYTE, OFF_ON_MAP, sizeof(WIFILED2_BYTE), userSettings.wifiLed);
         }
         
-        createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data));
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.print(F("HVAC> User wanted Wifi LED-> "));
-        DEBUG_PORT.println(wantedSettings.wifiLed);
-        #endif
+        if (!createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data))) return false;
+        wantedSettings.wifiLed = userSettings.wifiLed;
+        HVAC_LOG(HVAC_EV_USER_SETTING, FIELD_WIFILED, data[1]);
+        _unsentFields &= ~(1 << FIELD_WIFILED);
         _lastSyncSettings = millis();
         return true;
     }
+    #endif
     return false;
 }
 
-bool ToshibaCarrierHvac::processData(byte data[], size_t dataLen) {
+uint8_t ToshibaCarrierHvacCore::getFieldByFunction(byte function) {
+    if (function == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "WIFILED2")) return FIELD_WIFILED;
+    for (uint8_t i=0; i<sizeof(FIELD_FUNCTION); i++) {
+        if (FIELD_FUNCTION[i] == function) return i;
+    }
+    return 255;
+}
+
+const char* ToshibaCarrierHvacCore::getSettingName(uint8_t field, byte value) {
+    switch (field) {
+        case FIELD_STATE: return getNameByByte(OFF_ON_MAP, STATE_BYTE, sizeof(STATE_BYTE), value);
+        case FIELD_MODE: return getNameByByte(MODE_BYTE_MAP, MODE_BYTE, sizeof(MODE_BYTE), value);
+        #if HVAC_FEATURES & HVAC_FEATURE_SWING
+        case FIELD_SWING: return getNameByByte(SWING_BYTE_MAP, SWING_BYTE, sizeof(SWING_BYTE), value);
+        #endif
+        case FIELD_FANMODE: return getNameByByte(FANMODE_BYTE_MAP, FANMODE_BYTE, sizeof(FANMODE_BYTE), value);
+        #if HVAC_FEATURES & HVAC_FEATURE_PURE
+        case FIELD_PURE: return getNameByByte(OFF_ON_MAP, PURE_BYTE, sizeof(PURE_BYTE), value);
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_PSEL
+        case FIELD_PSEL: return getNameByByte(PSEL_BYTE_MAP, PSEL_BYTE, sizeof(PSEL_BYTE), value);
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_OP
+        case FIELD_OP: return getNameByByte(OP_BYTE_MAP, OP_BYTE, sizeof(OP_BYTE), value);
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_WIFILED
+        case FIELD_WIFILED:
+            if (_wifiled) return getNameByByte(OFF_ON_MAP, WIFILED2_BYTE, sizeof(WIFILED2_BYTE), value);
+            return getNameByByte(OFF_ON_MAP, WIFILED1_BYTE, sizeof(WIFILED1_BYTE), value);
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_TIMERS
+        case FIELD_OFFTIMER:
+        case FIELD_ONTIMER: return getNameByByte(OFF_ON_MAP, TIMER_BYTE, sizeof(TIMER_BYTE), value);
+        #endif
+    }
+    return nullptr;
+}
+
+bool ToshibaCarrierHvacCore::updateSetting(uint8_t field, byte value) {
+    if (!hvacFieldEnabled(field)) return false;     // removed by HVAC_FEATURES
+    const char* hvacSettings::* member = SETTINGS_MEMBER[field];
+    int16_t oldValue = getSettingValue(&currentSettings, field);
+    if (field == FIELD_SETPOINT) {
+        if (currentSettings.setpoint == value) return confirmWrites(field);
+        oldValue = currentSettings.setpoint;
+        wantedSettings.setpoint = userSettings.setpoint = currentSettings.setpoint = value;
+    } else {
+        const char* name = getSettingName(field, value);
+        if (currentSettings.*member == name) return confirmWrites(field);
+        wantedSettings.*member = userSettings.*member = currentSettings.*member = name;
+    }
+    HVAC_LOG(HVAC_EV_FIELD, field, value);
+    recordChange(field, oldValue, getSettingValue(&currentSettings, field));
+    confirmWrites(field);
+    return true;
+}
+
+int16_t ToshibaCarrierHvacCore::getStatusValue(uint8_t field) {
+    switch (field) {
+        case FIELD_ROOMTEMP: return currentStatus.roomTemperature;
+        case FIELD_OUTSIDETEMP: return currentStatus.outsideTemperature;
+        #if HVAC_FEATURES & HVAC_FEATURE_TIMERS
+        case FIELD_OFFTIMER: return currentStatus.offTimer ? getByteByName(TIMER_BYTE, OFF_ON_MAP, sizeof(TIMER_BYTE), currentStatus.offTimer) : 255;
+        case FIELD_ONTIMER: return currentStatus.onTimer ? getByteByName(TIMER_BYTE, OFF_ON_MAP, sizeof(TIMER_BYTE), currentStatus.onTimer) : 255;
+        #endif
+        case FIELD_CDU_STATE: return currentStatus.running;
+    }
+    return 0;
+}
+
+bool ToshibaCarrierHvacCore::updateStatus(uint8_t field, int16_t value) {
+    if (!hvacFieldEnabled(field)) return false;     // removed by HVAC_FEATURES
+    int16_t oldValue = getStatusValue(field);
+    switch (field) {
+        case FIELD_ROOMTEMP: currentStatus.roomTemperature = value; break;
+        case FIELD_OUTSIDETEMP: currentStatus.outsideTemperature = value; break;
+        case FIELD_OFFTIMER: currentStatus.offTimer = getSettingName(field, value); break;
+        case FIELD_ONTIMER: currentStatus.onTimer = getSettingName(field, value); break;
+        case FIELD_CDU_STATE: currentStatus.running = value; break;
+    }
+    value = getStatusValue(field);
+    if (value == oldValue) return false;
+    HVAC_LOG(HVAC_EV_FIELD, field, value);
+    recordChange(field, oldValue, value);
+    return true;
+}
+
+void ToshibaCarrierHvacCore::recordChange(uint8_t field, int16_t oldValue, int16_t newValue) {
+    hvacEvent* event = &_events[_eventSeq % EVENT_BUFFER_SIZE];
+    event->time = millis();
+    event->field = field;
+    event->oldValue = oldValue;
+    event->newValue = newValue;
+    _eventSeq++;
+    _generation++;
+    // debounce callbacks
+    if (field < FIELD_ROOMTEMP) {
+        _settingsCallbackBucket++;
+        _lastSettingsCallback = millis();
+    } else {
+        _statusCallbackBucket++;
+        _lastStatusCallback = millis();
+    }
+    _updateCallbackBucket++;
+    _lastUpdateCallback = millis();
+}
+
+bool ToshibaCarrierHvacCore::processData(byte data[], size_t dataLen) {
     if (dataLen == 5) {     // process data group 1 - basic (mode, setpoint, fanmode, operation)
-        hvacSettings receiveSettings;
         if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "FN_GROUP_1")) {
-            receiveSettings.mode = getNameByByte(MODE_BYTE_MAP, MODE_BYTE, sizeof(MODE_BYTE), data[1]);
-            receiveSettings.setpoint = data[2];
-            receiveSettings.fanMode = getNameByByte(FANMODE_BYTE_MAP, FANMODE_BYTE, sizeof(FANMODE_BYTE), data[3]);
-            receiveSettings.operation = getNameByByte(OP_BYTE_MAP, OP_BYTE, sizeof(OP_BYTE), data[4]);
-            if ((currentSettings.mode != receiveSettings.mode)) {
-                if (settingsUpdatedCallback) {
-                    wantedSettings.mode = userSettings.mode = currentSettings.mode = receiveSettings.mode;
-                    _settingsCallbackBucket++;
-                    _lastSettingsCallback = millis();
-                } else if (updateCallback) {
-                    wantedSettings.mode = userSettings.mode = currentSettings.mode = receiveSettings.mode;
-                    _updateCallbackBucket++;
-                    _lastUpdateCallback = millis();
-                } else if (whichFunctionUpdatedCallback) {
-                    wantedSettings.mode = userSettings.mode = currentSettings.mode = receiveSettings.mode;
-                    whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), 176));
-                } else {
-                    wantedSettings.mode = userSettings.mode = currentSettings.mode = receiveSettings.mode;
-                }
-            }
-            if (currentSettings.setpoint != receiveSettings.setpoint) {
-                if (settingsUpdatedCallback) {
-                    wantedSettings.setpoint = userSettings.setpoint = currentSettings.setpoint = receiveSettings.setpoint;
-                    _settingsCallbackBucket++;
-                    _lastSettingsCallback = millis();
-                } else if (updateCallback) {
-                    wantedSettings.setpoint = userSettings.setpoint = currentSettings.setpoint = receiveSettings.setpoint;
-                    _updateCallbackBucket++;
-                    _lastUpdateCallback = millis();
-                } else if (whichFunctionUpdatedCallback) {
-                    wantedSettings.setpoint = userSettings.setpoint = currentSettings.setpoint = receiveSettings.setpoint;
-                    whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), 179));
-                } else {
-                    wantedSettings.setpoint = userSettings.setpoint = currentSettings.setpoint = receiveSettings.setpoint;
-                }
-            }
-            if (currentSettings.fanMode != receiveSettings.fanMode) {
-                if (settingsUpdatedCallback) {
-                    wantedSettings.fanMode = userSettings.fanMode = currentSettings.fanMode = receiveSettings.fanMode;
-                    _settingsCallbackBucket++;
-                    _lastSettingsCallback = millis();
-                } else if (updateCallback) {
-                    wantedSettings.fanMode = userSettings.fanMode = currentSettings.fanMode = receiveSettings.fanMode;
-                    _updateCallbackBucket++;
-                    _lastUpdateCallback = millis();
-                } else if (whichFunctionUpdatedCallback) {
-                    wantedSettings.fanMode = userSettings.fanMode = currentSettings.fanMode = receiveSettings.fanMode;
-                    whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), 160));
-                } else {
-                    wantedSettings.fanMode = userSettings.fanMode = currentSettings.fanMode = receiveSettings.fanMode;
-                }
-            }
-            if (currentSettings.operation != receiveSettings.operation) {
-                if (settingsUpdatedCallback) {
-                    wantedSettings.operation = userSettings.operation = currentSettings.operation = receiveSettings.operation;
-                    _settingsCallbackBucket++;
-                    _lastSettingsCallback = millis();
-                } else if (updateCallback) {
-                    wantedSettings.operation = userSettings.operation = currentSettings.operation = receiveSettings.operation;
-                    _updateCallbackBucket++;
-                    _lastUpdateCallback = millis();
-                } else if (whichFunctionUpdatedCallback) {
-                    wantedSettings.operation = userSettings.operation = currentSettings.operation = receiveSettings.operation;
-                    whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), 247));
-                } else {
-                    wantedSettings.operation = userSettings.operation = currentSettings.operation = receiveSettings.operation;
-                }
-            }
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.print(F("HVAC> Process data group 1 result: Mode-> "));
-            DEBUG_PORT.print(currentSettings.mode);
-            DEBUG_PORT.print(F(", Setpoint-> "));
-            DEBUG_PORT.print(currentSettings.setpoint);
-            DEBUG_PORT.print(F(", Fanmode-> "));
-            DEBUG_PORT.print(currentSettings.fanMode);
-            DEBUG_PORT.print(F(", Operation-> "));
-            DEBUG_PORT.println(currentSettings.operation);
-            #endif
-            return true;
+            HVAC_LOG(HVAC_EV_GROUP, 1);
+            markReceived(data[0]);
+            for (uint8_t i=0; i<sizeof(FN_GROUP_1_FUNCTION); i++) markReceived(FN_GROUP_1_FUNCTION[i]);
+            bool updated = updateSetting(FIELD_MODE, data[1]);
+            updated |= updateSetting(FIELD_SETPOINT, data[2]);
+            updated |= updateSetting(FIELD_FANMODE, data[3]);
+            updated |= updateSetting(FIELD_OP, data[4]);
+            return updated;
         } else {
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("HVAC> Received unknown data group."));
-            #endif
+            HVAC_LOG(HVAC_EV_UNKNOWN_GROUP, data[0]);
             return false;
         }
     } else if (dataLen == 2) {    // process single data
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.print(F("HVAC> Process data result: "));
-        #endif
         // connection status
         if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "STATUS")) {  // status
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.print(F("Status-> "));
-            #endif
             if (data[1] == getByteByName(STATUS_BYTE, STATUS_BYTE_MAP, sizeof(STATUS_BYTE), "READY")) {
-                #ifdef HVAC_DEBUG
-                DEBUG_PORT.println(F("READY"));
-                #endif
+                HVAC_LOG(HVAC_EV_READY);
                 if (!_connected) {
                     _connected = true;
+                    _generation++;
                     _ready = _handshake = false;
                 }
                 return true;
             } else {
-                #ifdef HVAC_DEBUG
-                DEBUG_PORT.println(getNameByByte(STATUS_BYTE_MAP, STATUS_BYTE, sizeof(STATUS_BYTE), data[1]));
-                #endif
+                HVAC_LOG(HVAC_EV_UNKNOWN_STATUS, data[1]);
                 return false;
             }
         }
         // data
-        if (_connected) {   // process data when connected
-            if ((data[0] == 187) || (data[0] == 190) || (data[0] == 144) || (data[0] == 148)) {    // status
-                hvacStatus receiveStatus;
-                if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "ROOMTEMP")) {    // room temperature
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.print(F("RoomTemp-> "));
-                    #endif
-                    receiveStatus.roomTemperature = temperatureCorrection(data[1]);
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.println(receiveStatus.roomTemperature);
-                    #endif
-                    if (currentStatus.roomTemperature != receiveStatus.roomTemperature) {
-                        if (statusUpdatedCallback) {
-                            currentStatus.roomTemperature = receiveStatus.roomTemperature;
-                            _statusCallbackBucket++;
-                            _lastStatusCallback = millis();
-                            return true;
-                        } else if (updateCallback) {
-                            currentStatus.roomTemperature = receiveStatus.roomTemperature;
-                            _updateCallbackBucket++;
-                            _lastUpdateCallback = millis();
-                            return true;
-                        } else if (whichFunctionUpdatedCallback) {
-                            currentStatus.roomTemperature = receiveStatus.roomTemperature;
-                            whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), data[0]));
-                            return true;
-                        } else {
-                            currentStatus.roomTemperature = receiveStatus.roomTemperature;
-                            return true;
-                        }
-                    }
-                    return false;
-                }
-                if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "OUTSIDETEMP")) { // outside temperature and cdu state
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.print(F("OutsideTemp-> "));
-                    #endif
-                    receiveStatus.outsideTemperature = temperatureCorrection(data[1]);
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.println(receiveStatus.outsideTemperature);
-                    #endif
-                    if (receiveStatus.outsideTemperature == 127) {  // cdu not running, not update outside temperature and update cdu state
-                        #ifdef HVAC_DEBUG
-                        DEBUG_PORT.println(F("HVAC> Not update outside temperature, condensing unit not running"));
-                        #endif
-                        receiveStatus.running = false;
-                        if (currentStatus.running != receiveStatus.running) {
-                            if (statusUpdatedCallback) {
-                                currentStatus.running = receiveStatus.running;
-                                _statusCallbackBucket++;
-                                _lastStatusCallback = millis();
-                                return true;
-                            } else if (updateCallback) {
-                                currentStatus.running = receiveStatus.running;
-                                _updateCallbackBucket++;
-                                _lastUpdateCallback = millis();
-                                return true;
-                            } else if (whichFunctionUpdatedCallback) {
-                                currentStatus.running = receiveStatus.running;
-                                whichFunctionUpdatedCallback("CDU_STATE");
-                                return true;
-                            } else {
-                                currentStatus.running = receiveStatus.running;
-                                return true;
-                            }
-                        }
-                        return false;
-                    } else if (currentStatus.outsideTemperature != receiveStatus.outsideTemperature) {
-                        currentStatus.running = true;
-                        if (statusUpdatedCallback) {
-                            currentStatus.outsideTemperature = receiveStatus.outsideTemperature;
-                            _statusCallbackBucket++;
-                            _lastStatusCallback = millis();
-                            return true;
-                        } else if (updateCallback) {
-                            currentStatus.outsideTemperature = receiveStatus.outsideTemperature;
-                            _updateCallbackBucket++;
-                            _lastUpdateCallback = millis();
-                            return true;
-                        } else if (whichFunctionUpdatedCallback) {
-                            currentStatus.outsideTemperature = receiveStatus.outsideTemperature;
-                            whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), data[0]));
-                            whichFunctionUpdatedCallback("CDU_STATE");
-                        } else {
-                            currentStatus.outsideTemperature = receiveStatus.outsideTemperature;
-                            return true;
-                        }
-                    }
-                    return false;
-                }
-                if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "OFFTIMER")) {   // off timer
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.print(F("OffTimer-> "));
-                    #endif
-                    receiveStatus.offTimer = getNameByByte(OFF_ON_MAP, TIMER_BYTE, sizeof(TIMER_BYTE), data[1]);
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.println(receiveStatus.offTimer);
-                    #endif
-                    if (currentStatus.offTimer != receiveStatus.offTimer) {
-                        if (statusUpdatedCallback) {
-                            currentStatus.offTimer = receiveStatus.offTimer;
-                            _statusCallbackBucket++;
-                            _lastStatusCallback = millis();
-                            return true;
-                        } else if (updateCallback) {
-                            currentStatus.offTimer = receiveStatus.offTimer;
-                            _updateCallbackBucket++;
-                            _lastUpdateCallback = millis();
-                            return true;
-                        } else if (whichFunctionUpdatedCallback) {
-                            currentStatus.offTimer = receiveStatus.offTimer;
-                            whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), data[0]));
-                            return true;
-                        } else {
-                            currentStatus.offTimer = receiveStatus.offTimer;
-                            return true;
-                        }
-                    }
-                    return false;
-                }
-                if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "ONTIMER")) {   // on timer
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.print(F("OnTimer-> "));
-                    #endif
-                    receiveStatus.onTimer = getNameByByte(OFF_ON_MAP, TIMER_BYTE, sizeof(TIMER_BYTE), data[1]);
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.println(receiveStatus.onTimer);
-                    #endif
-                    if (currentStatus.onTimer != receiveStatus.onTimer) {
-                        if (statusUpdatedCallback) {
-                            currentStatus.onTimer = receiveStatus.onTimer;
-                            _statusCallbackBucket++;
-                            _lastStatusCallback = millis();
-                            return true;
-                        } else if (updateCallback) {
-                            currentStatus.onTimer = receiveStatus.onTimer;
-                            _updateCallbackBucket++;
-                            _lastUpdateCallback = millis();
-                            return true;
-                        } else if (whichFunctionUpdatedCallback) {
-                            currentStatus.onTimer = receiveStatus.onTimer;
-                            whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), data[0]));
-                            return true;
-                        } else {
-                            currentStatus.onTimer = receiveStatus.onTimer;
-                            return true;
-                        }
-                    }
-                    return false;
-                }
-                return false;
-            } else {    // setting
-                hvacSettings receiveSettings;
-                if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "STATE")) {   // state
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.print(F("State-> "));
-                    #endif
-                    receiveSettings.state = getNameByByte(OFF_ON_MAP, STATE_BYTE, sizeof(STATE_BYTE), data[1]);
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.println(receiveSettings.state);
-                    #endif
-                    if (currentSettings.state != receiveSettings.state) {
-                        if (settingsUpdatedCallback) {
-                            wantedSettings.state = userSettings.state = currentSettings.state = receiveSettings.state;
-                            _settingsCallbackBucket++;
-                            _lastSettingsCallback = millis();
-                            return true;
-                        } else if (updateCallback) {
-                            wantedSettings.state = userSettings.state = currentSettings.state = receiveSettings.state;
-                            _updateCallbackBucket++;
-                            _lastUpdateCallback = millis();
-                            return true;
-                        } else if (whichFunctionUpdatedCallback) {
-                            wantedSettings.state = userSettings.state = currentSettings.state = receiveSettings.state;
-                            whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), data[0]));
-                            return true;
-                        } else {
-                            wantedSettings.state = userSettings.state = currentSettings.state = receiveSettings.state;
-                            return true;
-                        }
-                    }
-                    return false;
-                }
-                if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "SETPOINT")) {    // setpoint
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.print(F("Setpoint-> "));
-                    #endif
-                    receiveSettings.setpoint = data[1];
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.println(receiveSettings.setpoint);
-                    #endif
-                    if (currentSettings.setpoint != receiveSettings.setpoint) {
-                        if (settingsUpdatedCallback) {
-                            wantedSettings.setpoint = userSettings.setpoint = currentSettings.setpoint = receiveSettings.setpoint;
-                            _settingsCallbackBucket++;
-                            _lastSettingsCallback = millis();
-                            return true;
-                        } else if (updateCallback) {
-                            wantedSettings.setpoint = userSettings.setpoint = currentSettings.setpoint = receiveSettings.setpoint;
-                            _updateCallbackBucket++;
-                            _lastUpdateCallback = millis();
-                            return true;
-                        } else if (whichFunctionUpdatedCallback) {
-                            wantedSettings.setpoint = userSettings.setpoint = currentSettings.setpoint = receiveSettings.setpoint;
-                            whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), data[0]));
-                            return true;
-                        } else {
-                            wantedSettings.setpoint = userSettings.setpoint = currentSettings.setpoint = receiveSettings.setpoint;
-                            return true;
-                        }
-                    }
-                    return false;
-                }
-                if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "MODE")) {    // mode
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.print(F("Mode-> "));
-                    #endif
-                    receiveSettings.mode = getNameByByte(MODE_BYTE_MAP, MODE_BYTE, sizeof(MODE_BYTE), data[1]);
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.println(receiveSettings.mode);
-                    #endif
-                    if (currentSettings.mode != receiveSettings.mode) {
-                        if (settingsUpdatedCallback) {
-                            wantedSettings.mode = userSettings.mode = currentSettings.mode = receiveSettings.mode;
-                            _settingsCallbackBucket++;
-                            _lastSettingsCallback = millis();
-                            return true;
-                        } else if (updateCallback) {
-                            wantedSettings.mode = userSettings.mode = currentSettings.mode = receiveSettings.mode;
-                            _updateCallbackBucket++;
-                            _lastUpdateCallback = millis();
-                            return true;
-                        } else if (whichFunctionUpdatedCallback) {
-                            wantedSettings.mode = userSettings.mode = currentSettings.mode = receiveSettings.mode;
-                            whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), data[0]));
-                            return true;
-                        } else {
-                            wantedSettings.mode = userSettings.mode = currentSettings.mode = receiveSettings.mode;
-                            return true;
-                        }
-                    }
-                    return false;
-                }
-                if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "SWING")) {   // swing
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.print(F("Swing-> "));
-                    #endif
-                    receiveSettings.swing = getNameByByte(SWING_BYTE_MAP, SWING_BYTE, sizeof(SWING_BYTE), data[1]);
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.println(receiveSettings.swing);
-                    #endif
-                    if (currentSettings.swing != receiveSettings.swing) {
-                        if (settingsUpdatedCallback) {
-                            wantedSettings.swing = userSettings.swing = currentSettings.swing = receiveSettings.swing;
-                            _settingsCallbackBucket++;
-                            _lastSettingsCallback = millis();
-                            return true;
-                        } else if (updateCallback) {
-                            wantedSettings.swing = userSettings.swing = currentSettings.swing = receiveSettings.swing;
-                            _updateCallbackBucket++;
-                            _lastUpdateCallback = millis();
-                            return true;
-                        } else if (whichFunctionUpdatedCallback) {
-                            wantedSettings.swing = userSettings.swing = currentSettings.swing = receiveSettings.swing;
-                            whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), data[0]));
-                            return true;
-                        } else {
-                            wantedSettings.swing = userSettings.swing = currentSettings.swing = receiveSettings.swing;
-                            return true;
-                        }
-                    }
-                    return false;
-                }
-                if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "FANMODE")) { // fan mode
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.print(F("Fanmode-> "));
-                    #endif
-                    receiveSettings.fanMode = getNameByByte(FANMODE_BYTE_MAP, FANMODE_BYTE, sizeof(FANMODE_BYTE), data[1]);
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.println(receiveSettings.fanMode);
-                    #endif
-                    if (currentSettings.fanMode != receiveSettings.fanMode) {
-                        if (settingsUpdatedCallback) {
-                            wantedSettings.fanMode = userSettings.fanMode = currentSettings.fanMode = receiveSettings.fanMode;
-                            _settingsCallbackBucket++;
-                            _lastSettingsCallback = millis();
-                            return true;
-                        } else if (updateCallback) {
-                            wantedSettings.fanMode = userSettings.fanMode = currentSettings.fanMode = receiveSettings.fanMode;
-                            _updateCallbackBucket++;
-                            _lastUpdateCallback = millis();
-                            return true;
-                        } else if (whichFunctionUpdatedCallback) {
-                            wantedSettings.fanMode = userSettings.fanMode = currentSettings.fanMode = receiveSettings.fanMode;
-                            whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), data[0]));
-                            return true;
-                        } else {
-                            wantedSettings.fanMode = userSettings.fanMode = currentSettings.fanMode = receiveSettings.fanMode;
-                            return true;
-                        }
-                    }
-                    return false;
-                }
-                if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "PURE")) {    // pure
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.print(F("Pure-> "));
-                    #endif
-                    receiveSettings.pure = getNameByByte(OFF_ON_MAP, PURE_BYTE, sizeof(PURE_BYTE), data[1]);
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.println(receiveSettings.pure);
-                    #endif
-                    if (currentSettings.pure != receiveSettings.pure) {
-                        if (settingsUpdatedCallback) {
-                            wantedSettings.pure = userSettings.pure = currentSettings.pure = receiveSettings.pure;
-                            _settingsCallbackBucket++;
-                            _lastSettingsCallback = millis();
-                            return true;
-                        } else if (updateCallback) {
-                            wantedSettings.pure = userSettings.pure = currentSettings.pure = receiveSettings.pure;
-                            _updateCallbackBucket++;
-                            _lastUpdateCallback = millis();
-                            return true;
-                        } else if (whichFunctionUpdatedCallback) {
-                            wantedSettings.pure = userSettings.pure = currentSettings.pure = receiveSettings.pure;
-                            whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), data[0]));
-                            return true;
-                        } else {
-                            wantedSettings.pure = userSettings.pure = currentSettings.pure = receiveSettings.pure;
-                            return true;
-                        }
-                    }
-                    return false;
-                }
-                if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "PSEL")) {    // power select
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.print(F("PowerSelect-> "));
-                    #endif
-                    receiveSettings.powerSelect = getNameByByte(PSEL_BYTE_MAP, PSEL_BYTE, sizeof(PSEL_BYTE), data[1]);
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.println(receiveSettings.powerSelect);
-                    #endif
-                    if (currentSettings.powerSelect != receiveSettings.powerSelect) {
-                        if (settingsUpdatedCallback) {
-                            wantedSettings.powerSelect = userSettings.powerSelect = currentSettings.powerSelect = receiveSettings.powerSelect;
-                            _settingsCallbackBucket++;
-                            _lastSettingsCallback = millis();
-                            return true;
-                        } else if (updateCallback) {
-                            wantedSettings.powerSelect = userSettings.powerSelect = currentSettings.powerSelect = receiveSettings.powerSelect;
-                            _updateCallbackBucket++;
-                            _lastUpdateCallback = millis();
-                            return true;
-                        } else if (whichFunctionUpdatedCallback) {
-                            wantedSettings.powerSelect = userSettings.powerSelect = currentSettings.powerSelect = receiveSettings.powerSelect;
-                            whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), data[0]));
-                            return true;
-                        } else {
-                            wantedSettings.powerSelect = userSettings.powerSelect = currentSettings.powerSelect = receiveSettings.powerSelect;
-                            return true;
-                        }
-                    }
-                    return false;
-                }
-                if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "OP")) {    // operation
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.print(F("Operation-> "));
-                    #endif
-                    receiveSettings.operation = getNameByByte(OP_BYTE_MAP, OP_BYTE, sizeof(OP_BYTE), data[1]);
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.println(receiveSettings.operation);
-                    #endif
-                    if (currentSettings.operation != receiveSettings.operation) {
-                        if (settingsUpdatedCallback) {
-                            wantedSettings.operation = userSettings.operation = currentSettings.operation = receiveSettings.operation;
-                            _settingsCallbackBucket++;
-                            _lastSettingsCallback = millis();
-                            return true;
-                        } else if (updateCallback) {
-                            wantedSettings.operation = userSettings.operation = currentSettings.operation = receiveSettings.operation;
-                            _updateCallbackBucket++;
-                            _lastUpdateCallback = millis();
-                            return true;
-                        } else if (whichFunctionUpdatedCallback) {
-                            wantedSettings.operation = userSettings.operation = currentSettings.operation = receiveSettings.operation;
-                            whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), data[0]));
-                            return true;
-                        } else {
-                            wantedSettings.operation = userSettings.operation = currentSettings.operation = receiveSettings.operation;
-                            return true;
-                        }
-                    }
-                    return false;
-                }
-                if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "WIFILED1")) {    // wifi led 1
-                    _wifiled = false;
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.print(F("WifiLED1-> "));
-                    #endif
-                    receiveSettings.wifiLed = getNameByByte(OFF_ON_MAP, WIFILED1_BYTE, sizeof(WIFILED1_BYTE), data[1]);
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.println(receiveSettings.wifiLed);
-                    #endif
-                    if (currentSettings.wifiLed != receiveSettings.wifiLed) {
-                        if (settingsUpdatedCallback) {
-                            wantedSettings.wifiLed = userSettings.wifiLed = currentSettings.wifiLed = receiveSettings.wifiLed;
-                            _settingsCallbackBucket++;
-                            _lastSettingsCallback = millis();
-                            return true;
-                        } else if (updateCallback) {
-                            wantedSettings.wifiLed = userSettings.wifiLed = currentSettings.wifiLed = receiveSettings.wifiLed;
-                            _updateCallbackBucket++;
-                            _lastUpdateCallback = millis();
-                            return true;
-                        } else if (whichFunctionUpdatedCallback) {
-                            wantedSettings.wifiLed = userSettings.wifiLed = currentSettings.wifiLed = receiveSettings.wifiLed;
-                            whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), data[0]));
-                            return true;
-                        } else {
-                            wantedSettings.wifiLed = userSettings.wifiLed = currentSettings.wifiLed = receiveSettings.wifiLed;
-                            return true;
-                        }
-                    }
-                    return false;
-                }
-                if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "WIFILED2")) {    // wifi led 2
-                    _wifiled = true;
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.print(F("WifiLED2-> "));
-                    #endif
-                    receiveSettings.wifiLed = getNameByByte(OFF_ON_MAP, WIFILED2_BYTE, sizeof(WIFILED2_BYTE), data[1]);
-                    #ifdef HVAC_DEBUG
-                    DEBUG_PORT.println(receiveSettings.wifiLed);
-                    #endif
-                    if (currentSettings.wifiLed != receiveSettings.wifiLed) {
-                        if (settingsUpdatedCallback) {
-                            wantedSettings.wifiLed = userSettings.wifiLed = currentSettings.wifiLed = receiveSettings.wifiLed;
-                            _settingsCallbackBucket++;
-                            _lastSettingsCallback = millis();
-                            return true;
-                        } else if (updateCallback) {
-                            wantedSettings.wifiLed = userSettings.wifiLed = currentSettings.wifiLed = receiveSettings.wifiLed;
-                            _updateCallbackBucket++;
-                            _lastUpdateCallback = millis();
-                            return true;
-                        } else if (whichFunctionUpdatedCallback) {
-                            wantedSettings.wifiLed = userSettings.wifiLed = currentSettings.wifiLed = receiveSettings.wifiLed;
-                            whichFunctionUpdatedCallback(getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), data[0]));
-                            return true;
-                        } else {
-                            wantedSettings.wifiLed = userSettings.wifiLed = currentSettings.wifiLed = receiveSettings.wifiLed;
-                            return true;
-                        }
-                    }
-                    return false;
+        if (_connected || _listenOnly) {    // process data when connected, sniffer may start in the middle of a session
+            markReceived(data[0]);
+            if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "ROOMTEMP")) {    // room temperature
+                return updateStatus(FIELD_ROOMTEMP, temperatureCorrection(data[1]));
+            }
+            if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "OUTSIDETEMP")) { // outside temperature and cdu state
+                int8_t outsideTemperature = temperatureCorrection(data[1]);
+                if (outsideTemperature == 127) {    // cdu not running, not update outside temperature and update cdu state
+                    HVAC_LOG(HVAC_EV_OUTSIDE_SKIPPED);
+                    return updateStatus(FIELD_CDU_STATE, false);
                 }
-                #ifdef HVAC_DEBUG
-                DEBUG_PORT.println(F("error: Received unknown function, skipped"));
-                #endif
-                return false;
+                bool updated = updateStatus(FIELD_OUTSIDETEMP, outsideTemperature);
+                updated |= updateStatus(FIELD_CDU_STATE, true);
+                return updated;
             }
+            if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "OFFTIMER")) {   // off timer
+                return updateStatus(FIELD_OFFTIMER, data[1]);
+            }
+            if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "ONTIMER")) {   // on timer
+                return updateStatus(FIELD_ONTIMER, data[1]);
+            }
+            // setting
+            if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "WIFILED1")) _wifiled = false;  // wifi led 1
+            if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "WIFILED2")) _wifiled = true;   // wifi led 2
+            uint8_t field = getFieldByFunction(data[0]);
+            if (field < FIELD_ROOMTEMP) return updateSetting(field, data[1]);
+            HVAC_LOG(HVAC_EV_UNKNOWN_FUNCTION, data[0]);
+            return false;
         } else {    // received data when not connected
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("error: Received data when not connected, skipped"));
-            #endif
+            HVAC_LOG(HVAC_EV_NOT_CONNECTED);
             return false;
         }
     } else if (dataLen == 1) {    // setting changed reply
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.print(F("HVAC> Received setting changed reply-> "));
-        #endif
+        HVAC_LOG(HVAC_EV_SETTING_CHANGED, getFieldByFunction(data[0]));
         if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "STATE")) {   // state
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("STATE"));
-            #endif
-            return createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, 1);
+            return sendQuery(data[0]);
         }
         if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "SETPOINT")) {    // setpoint
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("SETPOINT"));
-            #endif
-            return createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, 1);
+            return sendQuery(data[0]);
         }
         if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "MODE")) {    // mode
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("MODE"));
-            #endif
-            return createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, 1);
+            return sendQuery(data[0]);
         }
         if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "SWING")) {   // swing
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("SWING"));
-            #endif
-            return createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, 1);
+            return sendQuery(data[0]);
         }
         if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "FANMODE")) { //fan mode
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("FANMODE"));
-            #endif
-            return createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, 1);
+            return sendQuery(data[0]);
         }
         if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "PURE")) {    // pure
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("PURE"));
-            #endif
-            return createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, 1);
+            return sendQuery(data[0]);
         }
         if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "PSEL")) {    // power select
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("PSEL"));
-            #endif
-            return createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, 1);
+            return sendQuery(data[0]);
         }
         if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "OP")) {    // operation
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("OP"));
-            #endif
-            return createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, 1);
+            return sendQuery(data[0]);
         }
         if (data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "WIFILED1") ||
             data[0] == getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "WIFILED2")) {    // wifi led 1 and 2
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("WifiLED"));
-            #endif
-            return createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, 1);
+            return sendQuery(data[0]);
         }
         return false;
     } else {    // received unknown data
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.println(F("HVAC> Received unknown data, ignored"));
-        #endif
+        HVAC_LOG(HVAC_EV_UNKNOWN_DATA, dataLen);
         return false;
     }
     return false;
 }
 
-bool ToshibaCarrierHvac::readPacket(byte data[], size_t dataLen) {
+bool ToshibaCarrierHvacCore::readPacket(byte data[], size_t dataLen) {
+    // payload length from the wire is checked against frame length, frame is already a copy so payload is used in place
+    uint8_t offset = payloadOffset(data, dataLen);
+    byte* newData = data + offset;
+    uint8_t newDataLen = offset ? data[offset - 1] : 0;
+    if (((data[3] == getByteByName(PACKET_TYPE, PACKET_TYPE_MAP, sizeof(PACKET_TYPE), "FEEDBACK")) ||
+         (data[3] == getByteByName(PACKET_TYPE, PACKET_TYPE_MAP, sizeof(PACKET_TYPE), "REPLY")) ||
+         (data[3] == getByteByName(PACKET_TYPE, PACKET_TYPE_MAP, sizeof(PACKET_TYPE), "COMMAND"))) && !newDataLen) {
+        HVAC_LOG(HVAC_EV_RX_MALFORMED, data[3]);
+        return false;
+    }
     if (data[3] == getByteByName(PACKET_TYPE, PACKET_TYPE_MAP, sizeof(PACKET_TYPE), "FEEDBACK")) {  // feedback
-        byte newData[data[11]];
-        memcpy(newData, data + 12, data[11]);   // copy only data to newData
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.print(F("HVAC> Received feedback from hvac with data: "));
-        for (uint8_t i=0; i<data[11]; i++) {
-            DEBUG_PORT.print(newData[i]);
-            DEBUG_PORT.print(" ");
-        }
-        DEBUG_PORT.println("");
-        #endif
+        HVAC_LOG(HVAC_EV_FEEDBACK, newDataLen, newData[0], (newDataLen > 1) ? newData[1] : -1);
         byte reply_data[1] = {136};
-        if (data[4] > MAX_FEEDBACK_COUNT) { // query temperature after received x feedback(s) to avoid front panel blinking.
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("HVAC> Max feedback count reached, sending temperature query."));
-            #endif
+        if ((data[4] > MAX_FEEDBACK_COUNT) && !_listenOnly) { // query temperature after received x feedback(s) to avoid front panel blinking.
+            HVAC_LOG(HVAC_EV_FEEDBACK_MAX);
             queryTemperature();
         }
-        return processData(newData, data[11]);
+        return processData(newData, newDataLen);
     } else if (data[3] == getByteByName(PACKET_TYPE, PACKET_TYPE_MAP, sizeof(PACKET_TYPE), "REPLY")) {  // reply
-        byte newData[data[13]];
-        memcpy(newData, data + 14, data[13]);   // copy only data to newData
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.print(F("HVAC> Received reply from hvac with data: "));
-        for (uint8_t i=0; i<data[13]; i++) {
-            DEBUG_PORT.print(newData[i]);
-            DEBUG_PORT.print(" ");
+        HVAC_LOG(HVAC_EV_REPLY, newDataLen, newData[0], (newDataLen > 1) ? newData[1] : -1);
+        matchCalibrateReply(newData, newDataLen);
+        if (newDataLen > 1) {   // query reply, setting changed reply has only the function byte
+            completeQuery(newData[0]);
+            if (_heartbeatPending && (newData[0] == HEARTBEAT_FUNCTION)) heartbeatReply();
         }
-        DEBUG_PORT.println("");
-        #endif
-        return processData(newData, data[13]);
+        bool updated = processData(newData, newDataLen);
+        if (_pollPending && (newDataLen > 1) && (newData[0] == (isSupported(190) ? 190 : 187))) {   // last reply of poll
+            _pollPending = false;
+            updatePollInterval();
+        }
+        return updated;
+    } else if (data[3] == getByteByName(PACKET_TYPE, PACKET_TYPE_MAP, sizeof(PACKET_TYPE), "COMMAND")) {    // command of other device on the line
+        HVAC_LOG(HVAC_EV_COMMAND, newDataLen, newData[0], (newDataLen > 1) ? newData[1] : -1);
+        return false;
     } else if (data[3] == getByteByName(PACKET_TYPE, PACKET_TYPE_MAP, sizeof(PACKET_TYPE), "SYN/ACK")) {    // syn/ack
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.println(F("HVAC> Received handshake SYN/ACK"));
-        #endif
+        HVAC_LOG(HVAC_EV_SYNACK);
         _handshake = true;
         return true;
     } else if (data[3] == getByteByName(PACKET_TYPE, PACKET_TYPE_MAP, sizeof(PACKET_TYPE), "ACK")) {    // ack
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.println(F("HVAC> Received confirm handshake, your code may crash or hw problem cause node mcu restarted"));
-        #endif
+        HVAC_LOG(HVAC_EV_ACK);
         _ready = _handshake = false;
+        if (!_connected) _generation++;
         _connected = true;
         return true;
     } else {   // unknown
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.print(F("HVAC> Received "));
-        DEBUG_PORT.print(getNameByByte(PACKET_TYPE_MAP, PACKET_TYPE, sizeof(PACKET_TYPE_MAP), data[3]));
-        DEBUG_PORT.println(F(" packet from hvac"));
-        #endif
+        HVAC_LOG(HVAC_EV_UNKNOWN_PACKET, data[3]);
         return false;
     }
 }
 
-bool ToshibaCarrierHvac::findHeader(byte data[], size_t dataLen, const byte header[], size_t headerLen) {
-    bool match[headerLen];
-    bool master[headerLen];
-    memset(master, 1, headerLen);
-    for (uint8_t i=0; i<headerLen; i++) {
-        if (header[i] == data[i]) match[i] = 1;
-    }
-    if (memcmp(match, master, headerLen) == 0) {
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.println(F("HVAC> Header of packet found"));
-        #endif
-        return true;
-    } else {
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.println(F("HVAC> Header of packet not found"));
-        #endif
-        return false;
+// offset of payload (function and values) of command, feedback and reply frames, 0 when frame has none or payload passes checksum
+uint8_t ToshibaCarrierHvacCore::payloadOffset(const byte frame[], uint8_t frameLen) {
+    uint8_t lengthIndex = 0;
+    if ((frame[3] == getByteByName(PACKET_TYPE, PACKET_TYPE_MAP, sizeof(PACKET_TYPE), "COMMAND")) ||
+        (frame[3] == getByteByName(PACKET_TYPE, PACKET_TYPE_MAP, sizeof(PACKET_TYPE), "FEEDBACK"))) lengthIndex = 11;
+    else if (frame[3] == getByteByName(PACKET_TYPE, PACKET_TYPE_MAP, sizeof(PACKET_TYPE), "REPLY")) lengthIndex = 13;
+    if (lengthIndex && (frameLen > lengthIndex + 1) && (frame[lengthIndex] <= frameLen - lengthIndex - 2)) return lengthIndex + 1;
+    return 0;
+}
+
+// view of received frame for onFrame, frame is still in receive buffer
+hvacFrame ToshibaCarrierHvacCore::frameView(const byte frame[], uint8_t frameLen) {
+    hvacFrame view {_lastRxStart, frame, frameLen, frame[3], frame[4], nullptr, 0, hvacChecksumValid(frame, frameLen)};
+    uint8_t offset = payloadOffset(frame, frameLen);
+    if (offset) {
+        view.payload = frame + offset;
+        view.payloadLength = frame[offset - 1];
     }
+    return view;
 }
 
-uint8_t ToshibaCarrierHvac::findHeaderStart(byte data[], size_t dataLen, const byte header[], size_t headerLen) {
-  byte data2[dataLen];
-  byte temp;
-  uint8_t num=0;
-  memcpy(data2, data, dataLen);
-  while (((data2[0] != header[0]) || (data2[1] != header[1]) || (data2[2] != header[2])) && (num < dataLen)) {
-    byte temp = data2[0];
-    for (uint8_t i=0; i<dataLen; i++) {
-      data2[i] = data2[i+1];
-    }
-    data2[dataLen-1] = temp;
-    num++;
-  }
-  if (num == dataLen) {
-      #ifdef HVAC_DEBUG
-      DEBUG_PORT.println(F("HVAC> Header start not found"));
-      #endif
-      return 255;
-  } else {
-      if (num > 0) {
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.print(F("HVAC> Header start found at: "));
-            DEBUG_PORT.println(num+1);
-            #endif
-            return num;
-        } else {
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.print(F("HVAC> Header start found at: "));
-            DEBUG_PORT.println(num);
-            #endif
-            return num;
+bool ToshibaCarrierHvacCore::assembleFrames(void) {
+    bool processed = false;
+    while (_rxLen) {
+        if ((_rxBuffer[0] != 2) || ((_rxLen > 1) && (_rxBuffer[1] != 0)) || ((_rxLen > 2) && (_rxBuffer[2] != 0) && (_rxBuffer[2] != 2) && (_rxBuffer[2] != 3))) {
+            HVAC_LOG(HVAC_EV_RX_SKIP, _rxBuffer[0]);
+            dropFrameBytes(1);  // resync on next byte
+            continue;
         }
-  }
-}
-
-bool ToshibaCarrierHvac::chunkSplit(byte data[], size_t dataLen) {
-    uint8_t _start , start , restSize = dataLen;
-    if (!_ready && !_connected) _start = start = findHeaderStart(data, dataLen, HANDSHAKE_HEADER, sizeof(HANDSHAKE_HEADER));
-    else _start = start = findHeaderStart(data, dataLen, PACKET_HEADER, sizeof(PACKET_HEADER));
-    if (start == 255) {
-        _start = start = findHeaderStart(data, dataLen, CONFIRM_HEADER, sizeof(CONFIRM_HEADER));
-        if (start == 255) return false;
-    }
-    while(restSize >= 10) {
-        uint8_t dataSize = data[start+6] + 8;
-        if ((restSize >= dataSize) && ((dataSize >= 8) || (dataSize <= 17))) {
-            byte newData[dataSize];
-            for (;start < (dataSize+_start); start++) {
-                newData[start-_start] = data[start];
-            }
-            restSize -= dataSize;
-            _start = start;
-            yield();
-            if (readPacket(newData, dataSize));
-        } else if (dataSize == 14) {
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("HVAC> Received query packet, ignored"));
-            #endif
-            restSize -= dataSize;
-            _start = start;
-        } else if (dataSize >= 250) {
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("HVAC> Received large packet, not process this packet to avoid overflow"));
-            #endif
-            return false;
-        } else {
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("HVAC> Packet length invalid"));
-            #endif
-            return false;
+        if (_rxLen < 7) break;  // wait for length
+        uint16_t frameLen = _rxBuffer[6] + 8;
+        if (frameLen > RX_FRAME_BUFFER_SIZE) {
+            HVAC_LOG(HVAC_EV_RX_LARGE, frameLen);
+            dropFrameBytes(1);
+            continue;
+        }
+        if (_rxLen < frameLen) break;   // wait for rest of packet
+        if (_tapFrames) tapFrame(frameView(_rxBuffer, frameLen));  // not copied, broken frames too
+        if (!hvacChecksumValid(_rxBuffer, frameLen)) {
+            HVAC_LOG(HVAC_EV_RX_CHECKSUM, _rxBuffer[3]);
+            dropFrameBytes(frameLen);
+            continue;
+        }
+        byte frame[frameLen];
+        memcpy(frame, _rxBuffer, frameLen);
+        dropFrameBytes(frameLen);   // before processing, reply may query and read again
+        yield();
+        {
+            HVAC_PROFILE_SCOPE(PROFILE_DECODE);
+            if (readPacket(frame, frameLen)) processed = true;
         }
+        if (_rxLen && overBudget(PENDING_RX)) break;
     }
-    return true;
+    return processed;
 }
 
-bool ToshibaCarrierHvac::packetMonitor(void) {
-    if (_serial->available()) { // if received 1st data then continue to read rest of data until timeout
-        byte rxBuffer[MAX_RX_BYTE_READ];
-        uint8_t dataLen = 0;
-        uint32_t start = millis();
-        while (((millis() - start) < RX_READ_TIMEOUT) && (dataLen < MAX_RX_BYTE_READ)) {
-            if (_serial->available()) {
-                uint8_t c = _serial->read();
-                rxBuffer[dataLen++] = c;
-            }
-        }
+void ToshibaCarrierHvacCore::dropFrameBytes(uint8_t count) {
+    _rxLen -= count;
+    memmove(_rxBuffer, _rxBuffer + count, _rxLen);
+}
 
-        #ifdef HVAC_DEBUG
-        if ((MAX_RX_BYTE_READ - dataLen) < 1) DEBUG_PORT.println(F("HVAC> Serial buffer almost full"));
-        DEBUG_PORT.print(F("HVAC> Received data length: "));
-        DEBUG_PORT.println(dataLen);
-        DEBUG_PORT.print(F("HVAC> Data: "));
-        for (uint8_t i=0; i<dataLen; i++) {
-            DEBUG_PORT.print(rxBuffer[i]);
-            DEBUG_PORT.print(" ");
+bool ToshibaCarrierHvacCore::packetMonitor(void) {
+    HVAC_PROFILE_SCOPE(PROFILE_RX);
+    bool processed = false;
+    size_t space, len;
+    flushTx();
+    do {    // read everything already received in chunks, frames are processed as soon as complete
+        space = RX_FRAME_BUFFER_SIZE - _rxLen;
+        len = readTransport(_rxBuffer + _rxLen, space);
+        if (len) {
+            if (!_rxLen) _lastRxStart = millis();
+            _rxLen += len;
+            _lastReceive = millis();
+            _heartbeatMissed = 0;
+            _sendWake = false;
+            if (!_connected) _sendWake = true;
+            HVAC_LOG(HVAC_EV_RX, len, _rxLen);
         }
-        DEBUG_PORT.println("");
-        #endif
-
-        _lastReceive = millis();
-        _sendWake = false;
-        if (!_connected) _sendWake = true;
-        if ((dataLen == 15) && (dataLen == 17) && findHeader(rxBuffer, dataLen, PACKET_HEADER, sizeof(PACKET_HEADER))) {
-            return readPacket(rxBuffer, dataLen);
-        } else return chunkSplit(rxBuffer, dataLen);
-    } else return false;
-}
-
-void ToshibaCarrierHvac::queryall(void) {
-    byte fn[11] = {128, 135, 144, 148, 163, 187, 190, 199, 222, 223, 248};
-    for (uint8_t i=0; i<11; i++) {
-        byte data[1] = {fn[i]};
-        createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, 1);
-        delay(200);
-        packetMonitor();
-        yield();
-    }
+        if (assembleFrames()) processed = true;
+        if (_deferred & PENDING_RX) return processed;  // out of time, complete packets are still buffered
+        if (!len && _rxLen && ((millis() - _lastReceive) >= RX_READ_TIMEOUT)) {
+            HVAC_LOG(HVAC_EV_RX_INCOMPLETE, _rxLen);
+            _rxLen = 0;
+        }
+    } while (len && (len == space) && !overBudget(PENDING_RX));
+    return processed;
 }
 
-void ToshibaCarrierHvac::queryTemperature(void) {
-    byte fn[2] = {187, 190};
-    for (uint8_t i=0; i<2; i++) {
-        byte data[1] = {fn[i]};
-        createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, 1);
-        delay(200);
+void ToshibaCarrierHvacCore::queryall(void) {
+    uint8_t sent = 0;
+    for (uint8_t i=0; i<sizeof(QUERYALL_FUNCTION); i++) {
+        if (isReceived(QUERYALL_FUNCTION[i])) continue;
+        sent++;
+        if (queueQueries()) {   // sent by pumpQueries, group functions wait for group reply
+            queueQuery(QUERYALL_FUNCTION[i]);
+            continue;
+        }
+        sendQuery(QUERYALL_FUNCTION[i]);
+        delay(_pacing.queryGap);
         packetMonitor();
         yield();
     }
+    HVAC_LOG(HVAC_EV_QUERYALL, sent, sizeof(QUERYALL_FUNCTION) - sent);
 }
 
-void ToshibaCarrierHvac::handleHvac(void) {
-    if (!_connected) {
-        sendHandshake();
+uint16_t ToshibaCarrierHvacCore::getFunctionBit(byte function) {
+    for (uint8_t i=0; i<sizeof(FUNCTION_BYTE); i++) {
+        if (FUNCTION_BYTE[i] == function) return 1U << i;
     }
+    return 0;
+}
 
-    if (_firstRun) {
-        _idleTimeout = IDLE_TIMEOUT * 60 * 1000;
-        _connectionTimeout = CONNECTION_TIMEOUT * 60 * 1000;
-        _queryallDelay = START_DELAY * 1000;
-        _firstRun = false;
-    }
+void ToshibaCarrierHvacCore::markReceived(byte function) {
+    _receivedFunctions |= getFunctionBit(function);
+    _queuedFunctions &= ~getFunctionBit(function);  // queued query already answered by feedback or group reply
+}
 
-    // query all data once after connected
-    if (((millis() - _lastReceive) >= _queryallDelay) && !_init && _connected) {
-        queryall();
-        _init = true;
-    }
+bool ToshibaCarrierHvacCore::isReceived(byte function) {
+    if ((HVAC_FEATURES != HVAC_FEATURE_ALL) && !hvacFieldEnabled(getFieldByFunction(function))) return true;  // removed by HVAC_FEATURES, never queried
+    if (!isSupported(function)) return true;    // not answered by this unit, never queried
+    return _receivedFunctions & getFunctionBit(function);
+}
 
-    packetMonitor();    // process data
+void ToshibaCarrierHvacCore::queueQuery(byte function) {
+    _receivedFunctions &= ~getFunctionBit(function);
+    _queuedFunctions |= getFunctionBit(function);
+}
 
-    // idle timeout
-    if (((millis() - _lastReceive) >= _idleTimeout) && !_sendWake && _init) {
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.println(F("HVAC> Max idle timeout reached"));
-        #endif
-        _sendWake = true;
-        // try to query temperature
-        queryTemperature();
-        _lastSendWake = millis();
+// next queued function in query all order, not already outstanding, group functions wait while group query is queued or outstanding
+byte ToshibaCarrierHvacCore::nextQuery(void) {
+    byte group = getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "FN_GROUP_1");
+    bool groupPending = _queuedFunctions & getFunctionBit(group);
+    uint16_t outstanding = 0;
+    for (uint8_t i=0; i<_queryPipeline; i++) {
+        outstanding |= getFunctionBit(_queries[i].function);
+        if (_queries[i].function == group) groupPending = true;
     }
-
-    // connection timeout
-    if (((millis() - _lastSendWake) >= _connectionTimeout) && _sendWake) {
-        #ifdef HVAC_DEBUG
-        DEBUG_PORT.println(F("HVAC> Connection timeout, try to send new handshake"));
-        #endif
-        _firstRun = true;
-        _handshake = _ready = _connected = _sendWake = _init = false;
-        _lastReceive = _lastSendWake = millis();
+    for (uint8_t i=0; i<sizeof(QUERYALL_FUNCTION); i++) {
+        byte function = QUERYALL_FUNCTION[i];
+        if (!(_queuedFunctions & getFunctionBit(function)) || (outstanding & getFunctionBit(function))) continue;
+        if (groupPending && memchr(FN_GROUP_1_FUNCTION, function, sizeof(FN_GROUP_1_FUNCTION))) continue;
+        return function;
     }
+    return 0;
+}
 
-    if(_init && ((millis() - _lastSyncSettings) >= SETTINGS_SEND_DELAY)) {
-        if (syncUserSettings()) {
-            #ifdef HVAC_DEBUG
-            DEBUG_PORT.println(F("HVAC> New setting has been sync, waiting for reply"));
-            #endif
-        }
-    }
-    // settings callback limit
-    if ((_settingsCallbackBucket == 1) && ((millis() - _lastSettingsCallback) >= SINGLE_QUEUE_TIMEOUT)) {
-        settingsUpdatedCallback(currentSettings);
-        _settingsCallbackBucket = 0;
-    } else if ((_settingsCallbackBucket > 1) && ((millis() - _lastSettingsCallback) >= MULTI_QUEUE_TIMEOUT)) {
-        settingsUpdatedCallback(currentSettings);
-        _settingsCallbackBucket = 0;
-    }
-    // status callback limit
-    if ((_statusCallbackBucket == 1) && ((millis() - _lastStatusCallback) >= SINGLE_QUEUE_TIMEOUT)) {
-        statusUpdatedCallback(currentStatus);
-        _statusCallbackBucket = 0;
-    } else if ((_statusCallbackBucket > 1) && ((millis() - _lastStatusCallback) >= MULTI_QUEUE_TIMEOUT)) {
-        statusUpdatedCallback(currentStatus);
-        _statusCallbackBucket = 0;
-    }
-    // update callback limit
-    if ((_updateCallbackBucket == 1) && ((millis() - _lastUpdateCallback) >= SINGLE_QUEUE_TIMEOUT)) {
-        updateCallback();
-        _updateCallbackBucket = 0;
-    } else if ((_updateCallbackBucket > 1) && ((millis() - _lastUpdateCallback) >= MULTI_QUEUE_TIMEOUT)) {
-        updateCallback();
-        _updateCallbackBucket = 0;
-    }
-}
-
-bool ToshibaCarrierHvac::sendCustomPacket(byte data[], size_t length) {
-    if ((length >= 8) && (length <= 17)) {
-        sendPacket(data, length);
-        return true;
-    } else {
-        return false;
+// reply matched to its query by function byte
+void ToshibaCarrierHvacCore::completeQuery(byte function) {
+    for (uint8_t i=0; i<MAX_QUERY_PIPELINE; i++) {
+        if (_queries[i].function == function) _queries[i].function = 0;
     }
 }
 
-void ToshibaCarrierHvac::applyPreset(hvacSettings newSettings) {
-    userSettings = newSettings;
+void ToshibaCarrierHvacCore::pumpQueries(void) {
+    bool idle = true;
+    for (uint8_t i=0; i<_queryPipeline; i++) {
+        hvacQuerySlot* query = &_queries[i];
+        if (query->function && ((millis() - query->sent) >= QUERY_REPLY_TIMEOUT)) {
+            if (query->retries < QUERY_MAX_RETRIES) {
+                HVAC_LOG(HVAC_EV_QUERY_RETRY, query->function);
+                if (sendQuery(query->function)) {
+                    query->retries++;
+                    query->sent = millis();
+                }
+            } else {
+                HVAC_LOG(HVAC_EV_QUERY_DROPPED, query->function);
+                query->function = 0;
+            }
+        }
+        if (!query->function && ((_queryPipeline > 1) || ((millis() - _lastQuery) >= _pacing.queryGap))) {     // one at a time keeps query delay
+            byte function = nextQuery();
+            if (function && sendQuery(function)) {
+                _queuedFunctions &= ~getFunctionBit(function);
+                *query = hvacQuerySlot {function, 0, millis()};
+                _lastQuery = millis();
+            }
+        }
+        if (query->function) idle = false;
+    }
+    if (idle && !_queuedFunctions) _revalidatePending = false;
 }
 
-void ToshibaCarrierHvac::setState(const char* newState) {
-    userSettings.state = newState;
+// queries are queued instead of sent with blocking delays when pipelined or time budget is used
+bool ToshibaCarrierHvacCore::queueQueries(void) {
+    return (_queryPipeline > 1) || _budget;
 }
 
-void ToshibaCarrierHvac::setSetpoint(uint8_t newSetpoint) {
-    userSettings.setpoint = newSetpoint;
+void ToshibaCarrierHvacCore::queryTemperature(void) {
+    byte fn[2] = {187, 190};
+    for (uint8_t i=0; i<2; i++) {
+        if (!isSupported(fn[i])) continue;
+        if (queueQueries()) {
+            queueQuery(fn[i]);
+            continue;
+        }
+        sendQuery(fn[i]);
+        delay(_pacing.queryGap);
+        packetMonitor();
+        yield();
+    }
 }
 
-void ToshibaCarrierHvac::setMode(const char* newMode) {
-    userSettings.mode = newMode;
+// reply of a calibration packet, matched by function so late replies of other queries don't count
+void ToshibaCarrierHvacCore::matchCalibrateReply(byte data[], size_t dataLen) {
+    if (_calibrateWrite != (dataLen == 1)) return;  // setting changed reply has only the function byte
+    for (uint8_t i=0; i<2; i++) {
+        if (_calibrateReply[i] && (data[0] == _calibrateReply[i])) {
+            _calibrateReply[i] = 0;
+            _lastReplyTime = _lastRxStart;
+            return;
+        }
+    }
 }
 
-void ToshibaCarrierHvac::setSwing(const char* newSwing) {
-    userSettings.swing = newSwing;
+bool ToshibaCarrierHvacCore::waitReplies(void) {
+    uint32_t start = millis();
+    while (((millis() - start) < CALIBRATE_REPLY_TIMEOUT) && (_calibrateReply[0] || _calibrateReply[1])) {
+        packetMonitor();
+        yield();
+    }
+    bool result = !_calibrateReply[0] && !_calibrateReply[1];
+    _calibrateReply[0] = _calibrateReply[1] = 0;   // late replies are not matched by next probe
+    return result;
 }
 
-void ToshibaCarrierHvac::setFanMode(const char* newFanMode) {
-    userSettings.fanMode = newFanMode;
+// two packets gap ms apart, queries of room temperature and state or current setpoint written twice
+bool ToshibaCarrierHvacCore::probePacing(bool settings, uint16_t gap) {
+    packetMonitor();    // flush pending data
+    _calibrateWrite = settings;
+    byte setpoint = currentSettings.setpoint;
+    byte data[2] = {getByteByName(FUNCTION_BYTE, FUNCTION_BYTE_MAP, sizeof(FUNCTION_BYTE), "SETPOINT"), setpoint};
+    const byte fn[2] = {187, 128};
+    bool result = true;
+    for (uint8_t i=0; (i<2) && result; i++) {
+        if (i > 0) delay(gap);
+        _calibrateReply[i] = settings ? data[0] : fn[i];
+        if (settings) result = createPacket(PACKET_HEADER, sizeof(PACKET_HEADER), 16, data, sizeof(data));
+        else result = sendQuery(fn[i]);
+    }
+    if (result) result = waitReplies() && (currentSettings.setpoint == setpoint);   // unit still reports the written value
+    else _calibrateReply[0] = _calibrateReply[1] = 0;   // not queued
+    HVAC_LOG(HVAC_EV_CALIBRATE_PROBE, settings, gap, result);
+    delay(settings ? SETTINGS_SEND_DELAY : QUERY_SEND_DELAY);   // let the unit settle before next probe
+    return result;
 }
 
-void ToshibaCarrierHvac::setPure(const char* newPure) {
-    userSettings.pure = newPure;
+// binary search between response latency and default delay, default delay is known to work
+uint16_t ToshibaCarrierHvacCore::calibrateGap(bool settings, uint16_t from) {
+    uint16_t fail = (_pacing.latency > CALIBRATE_MIN_DELAY) ? _pacing.latency : CALIBRATE_MIN_DELAY;
+    uint16_t pass = from;
+    for (uint8_t i=0; i<(settings ? CALIBRATE_SETTINGS_PROBES : CALIBRATE_QUERY_PROBES); i++) {
+        uint16_t gap = (fail + pass) / 2;
+        if (probePacing(settings, gap)) pass = gap;
+        else fail = gap;
+    }
+    pass += pass * CALIBRATE_MARGIN / 100;
+    return (pass < from) ? pass : from;
 }
 
-void ToshibaCarrierHvac::setPowerSelect(const char* newPowerSelect) {
-    userSettings.powerSelect = newPowerSelect;
+bool ToshibaCarrierHvacCore::calibratePacing(void) {
+    if (!_connected || !_init) return false;
+    _budget = 0;    // blocking, packets are processed without time budget
+    if ((currentSettings.mode == nullptr) || (currentSettings.setpoint < 17) || (currentSettings.setpoint > 30)) return false;   // unknown settings, can't write back
+    HVAC_LOG(HVAC_EV_CALIBRATE_START);
+    // outstanding pipelined queries are answered first, not answered ones are queried again after calibration
+    uint32_t start = millis();
+    while (((millis() - start) < CALIBRATE_REPLY_TIMEOUT) && _txLen) {
+        flushTx();
+        yield();
+    }
+    for (uint8_t i=0; i<_queryPipeline; i++) {
+        while (_queries[i].function && ((millis() - start) < CALIBRATE_REPLY_TIMEOUT)) {
+            packetMonitor();
+            yield();
+        }
+        if (_queries[i].function) {
+            queueQuery(_queries[i].function);
+            _queries[i].function = 0;
+        }
+    }
+    // response latency
+    uint32_t total = 0;
+    _calibrateWrite = false;
+    for (uint8_t i=0; i<3; i++) {
+        packetMonitor();
+        _calibrateReply[0] = 187;
+        if (!sendQuery(187)) return false;
+        uint32_t sent = millis();
+        if (!waitReplies()) return false;
+        total += _lastReplyTime - sent;
+    }
+    _pacing.latency = total / 3;
+    _pacing.queryGap = calibrateGap(false, QUERY_SEND_DELAY);
+    _pacing.settingsGap = calibrateGap(true, SETTINGS_SEND_DELAY);
+    _lastReceive = _lastSyncSettings = millis();
+    _sendWake = false;
+    HVAC_LOG(HVAC_EV_CALIBRATE_DONE, _pacing.latency, _pacing.queryGap, _pacing.settingsGap);
+    return true;
 }
 
-void ToshibaCarrierHvac::setOperation(const char* newOperation) {
-    userSettings.operation = newOperation;
+uint8_t ToshibaCarrierHvacCore::getIndexByName(const char* valMap[], size_t valLen, const char* name) {
+    for (uint8_t i=0; i<valLen; i++) {
+        if (valMap[i] == name) return i;
+    }
+    return 255;
 }
 
-void ToshibaCarrierHvac::setWifiLed(const char* newWifiLed) {
-    userSettings.wifiLed = newWifiLed;
+const char* ToshibaCarrierHvacCore::getNameByIndex(const char* valMap[], size_t valLen, uint8_t index) {
+    if (index < valLen) return valMap[index];
+    return nullptr;
 }
 
-hvacStatus ToshibaCarrierHvac::getStatus(void) {
-    return currentStatus;
+void ToshibaCarrierHvacCore::createCache(hvacCache* cache) {
+    memset(cache, 0, sizeof(hvacCache));
+    cache->magic = CACHE_MAGIC;
+    cache->settings[0] = getIndexByName(OFF_ON_MAP, 3, currentSettings.state);
+    cache->settings[1] = currentSettings.setpoint;
+    cache->settings[2] = getIndexByName(MODE_BYTE_MAP, 6, currentSettings.mode);
+    #if HVAC_FEATURES & HVAC_FEATURE_SWING
+    cache->settings[3] = getIndexByName(SWING_BYTE_MAP, 10, currentSettings.swing);
+    #endif
+    cache->settings[4] = getIndexByName(FANMODE_BYTE_MAP, 8, currentSettings.fanMode);
+    cache->settings[5] = getIndexByName(OFF_ON_MAP, 3, currentSettings.pure);
+    #if HVAC_FEATURES & HVAC_FEATURE_PSEL
+    cache->settings[6] = getIndexByName(PSEL_BYTE_MAP, 4, currentSettings.powerSelect);
+    #endif
+    #if HVAC_FEATURES & HVAC_FEATURE_OP
+    cache->settings[7] = getIndexByName(OP_BYTE_MAP, 9, currentSettings.operation);
+    #endif
+    cache->settings[8] = getIndexByName(OFF_ON_MAP, 3, currentSettings.wifiLed);
+    cache->wifiLedFn = _wifiled;
+    cache->pacing = _pacing;
+    cache->functions = _supportedFunctions;
+    cache->roomTemperature = currentStatus.roomTemperature;
+    cache->outsideTemperature = currentStatus.outsideTemperature;
+    cache->timers[0] = getIndexByName(OFF_ON_MAP, 3, currentStatus.offTimer);
+    cache->timers[1] = getIndexByName(OFF_ON_MAP, 3, currentStatus.onTimer);
+    cache->running = currentStatus.running;
+    uint8_t sum = 0;
+    for (uint8_t i=0; i<offsetof(hvacCache, checksum); i++) sum += ((uint8_t*)cache)[i];
+    cache->checksum = 256 - sum;
 }
 
-hvacSettings ToshibaCarrierHvac::getSettings(void) {
-    return currentSettings;
+bool ToshibaCarrierHvacCore::loadCache(void) {
+    hvacCache cache;
+    if (!_storage->read(_storageAddress, (uint8_t*)&cache, sizeof(cache))) return false;
+    uint8_t sum = 0;
+    for (uint8_t i=0; i<sizeof(cache); i++) sum += ((uint8_t*)&cache)[i];
+    if ((cache.magic != CACHE_MAGIC) || (sum != 0)) {
+        HVAC_LOG(HVAC_EV_CACHE_INVALID);
+        return false;
+    }
+    currentSettings.state = getNameByIndex(OFF_ON_MAP, 3, cache.settings[0]);
+    currentSettings.setpoint = cache.settings[1];
+    currentSettings.mode = getNameByIndex(MODE_BYTE_MAP, 6, cache.settings[2]);
+    #if HVAC_FEATURES & HVAC_FEATURE_SWING
+    currentSettings.swing = getNameByIndex(SWING_BYTE_MAP, 10, cache.settings[3]);
+    #endif
+    currentSettings.fanMode = getNameByIndex(FANMODE_BYTE_MAP, 8, cache.settings[4]);
+    currentSettings.pure = getNameByIndex(OFF_ON_MAP, 3, cache.settings[5]);
+    #if HVAC_FEATURES & HVAC_FEATURE_PSEL
+    currentSettings.powerSelect = getNameByIndex(PSEL_BYTE_MAP, 4, cache.settings[6]);
+    #endif
+    #if HVAC_FEATURES & HVAC_FEATURE_OP
+    currentSettings.operation = getNameByIndex(OP_BYTE_MAP, 9, cache.settings[7]);
+    #endif
+    currentSettings.wifiLed = getNameByIndex(OFF_ON_MAP, 3, cache.settings[8]);
+    _wifiled = cache.wifiLedFn;
+    setPacing(cache.pacing);
+    _supportedFunctions = cache.functions;
+    currentStatus.roomTemperature = cache.roomTemperature;
+    currentStatus.outsideTemperature = cache.outsideTemperature;
+    currentStatus.offTimer = getNameByIndex(OFF_ON_MAP, 3, cache.timers[0]);
+    currentStatus.onTimer = getNameByIndex(OFF_ON_MAP, 3, cache.timers[1]);
+    currentStatus.running = cache.running;
+    // unknown settings keep "UNKNOWN" to prevent strcasecmp crash
+    if (currentSettings.state) wantedSettings.state = userSettings.state = currentSettings.state;
+    wantedSettings.setpoint = userSettings.setpoint = currentSettings.setpoint;
+    if (currentSettings.mode) wantedSettings.mode = userSettings.mode = currentSettings.mode;
+    if (currentSettings.swing) wantedSettings.swing = userSettings.swing = currentSettings.swing;
+    if (currentSettings.fanMode) wantedSettings.fanMode = userSettings.fanMode = currentSettings.fanMode;
+    if (currentSettings.pure) wantedSettings.pure = userSettings.pure = currentSettings.pure;
+    if (currentSettings.powerSelect) wantedSettings.powerSelect = userSettings.powerSelect = currentSettings.powerSelect;
+    if (currentSettings.operation) wantedSettings.operation = userSettings.operation = currentSettings.operation;
+    if (currentSettings.wifiLed) wantedSettings.wifiLed = userSettings.wifiLed = currentSettings.wifiLed;
+    _savedCache = cache;
+    _generation++;
+    HVAC_LOG(HVAC_EV_CACHE_LOADED);
+    return true;
 }
 
-int8_t ToshibaCarrierHvac::getRoomTemperature(void) {
-    return currentStatus.roomTemperature;
+void ToshibaCarrierHvacCore::saveCache(void) {
+    hvacCache cache;
+    createCache(&cache);
+    // save only when settings changed, status will be saved together
+    if ((memcmp(cache.settings, _savedCache.settings, sizeof(cache.settings)) == 0) &&
+        (cache.wifiLedFn == _savedCache.wifiLedFn) &&
+        (memcmp(&cache.pacing, &_savedCache.pacing, sizeof(hvacPacing)) == 0) &&
+        (cache.functions == _savedCache.functions)) return;
+    if (_storage->write(_storageAddress, (uint8_t*)&cache, sizeof(cache))) {
+        _savedCache = cache;
+        HVAC_LOG(HVAC_EV_CACHE_SAVED);
+    }
 }
 
-int8_t ToshibaCarrierHvac::getOutsideTemperature(void) {
-    return currentStatus.outsideTemperature;
+void ToshibaCarrierHvacCore::revalidate(void) {
+    while ((_revalidateIndex < sizeof(QUERYALL_FUNCTION)) && isReceived(QUERYALL_FUNCTION[_revalidateIndex])) _revalidateIndex++;
+    if ((_queryPipeline > 1) && (_revalidateIndex < sizeof(QUERYALL_FUNCTION))) {   // queue remaining functions at once
+        for (; _revalidateIndex<sizeof(QUERYALL_FUNCTION); _revalidateIndex++) {
+            if (!isReceived(QUERYALL_FUNCTION[_revalidateIndex])) queueQuery(QUERYALL_FUNCTION[_revalidateIndex]);
+        }
+        _revalidatePending = true;
+        return;
+    }
+    if ((_revalidateIndex < sizeof(QUERYALL_FUNCTION)) && ((millis() - _lastRevalidate) >= _pacing.queryGap)) {
+        sendQuery(QUERYALL_FUNCTION[_revalidateIndex++]);
+        _lastRevalidate = millis();
+    }
 }
 
-const char* ToshibaCarrierHvac::getState(void) {
+byte ToshibaCarrierHvacCore::getSettingValue(hvacSettings* settings, uint8_t index) {
+    const char* name = nullptr;
+    switch (index) {
+        case 0: name = settings->state; break;
+        case 1: return (settings->setpoint < 17) ? 17 : ((settings->setpoint > 30) ? 30 : settings->setpoint);   // same as sync
+        case 2: name = settings->mode; break;
+        case 3: name = settings->swing; break;
+        case 4: name = settings->fanMode; break;
+        case 5: name = settings->pure; break;
+        case 6: name = settings->powerSelect; break;
+        case 7: name = settings->operation; break;
+        case 8: name = settings->wifiLed; break;
+    }
+    if (name == nullptr) return 255;
+    switch (index) {
+        case 0: return getByteByName(STATE_BYTE, OFF_ON_MAP, sizeof(STATE_BYTE), name);
+        case 2: return getByteByName(MODE_BYTE, MODE_BYTE_MAP, sizeof(MODE_BYTE), name);
+        #if HVAC_FEATURES & HVAC_FEATURE_SWING
+        case 3: return getByteByName(SWING_BYTE, SWING_BYTE_MAP, sizeof(SWING_BYTE), name);
+        #endif
+        case 4: return getByteByName(FANMODE_BYTE, FANMODE_BYTE_MAP, sizeof(FANMODE_BYTE), name);
+        #if HVAC_FEATURES & HVAC_FEATURE_PURE
+        case 5: return getByteByName(PURE_BYTE, OFF_ON_MAP, sizeof(PURE_BYTE), name);
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_PSEL
+        case 6: return getByteByName(PSEL_BYTE, PSEL_BYTE_MAP, sizeof(PSEL_BYTE), name);
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_OP
+        case 7: return getByteByName(OP_BYTE, OP_BYTE_MAP, sizeof(OP_BYTE), name);
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_WIFILED
+        case 8: return getByteByName(WIFILED1_BYTE, OFF_ON_MAP, sizeof(WIFILED1_BYTE), name);
+        #endif
+    }
+    return 255;     // removed by HVAC_FEATURES
+}
+
+// unused or oldest finished write slot, 255 when all are pending
+uint8_t ToshibaCarrierHvacCore::freeWriteSlot(void) {
+    uint8_t slot = 255;
+    for (uint8_t i=0; i<MAX_PENDING_WRITES; i++) {
+        if (_writes[i].state == WRITE_INVALID) return i;
+        if ((_writes[i].state != WRITE_PENDING) && ((slot == 255) || ((millis() - _writes[i].start) > (millis() - _writes[slot].start)))) slot = i;
+    }
+    return slot;
+}
+
+HvacWrite ToshibaCarrierHvacCore::createWrite(hvacSettings* newSettings, uint16_t mask) {
+    if (_listenOnly) {
+        HVAC_LOG(HVAC_EV_WRITE_LISTEN_ONLY);
+        return HvacWrite();
+    }
+    for (uint8_t i=0; i<9; i++) {
+        if ((mask & (1 << i)) && !isFieldSupported(i)) {
+            HVAC_LOG(HVAC_EV_WRITE_UNSUPPORTED, i);
+            mask &= ~(1 << i);
+        }
+    }
+    if (!mask) return HvacWrite();
+    // values are checked before anything changes, a rejected write is never sent and keeps user settings
+    byte value[9];
+    uint8_t count = 0;
+    bool valid = true;
+    for (uint8_t i=0; i<9; i++) {
+        if (!(mask & (1 << i))) continue;
+        value[i] = getSettingValue(newSettings, i);
+        if (value[i] == 255) valid = false;
+        count++;
+    }
+    if (valid) {
+        // latest value wins, unsent older values of the same functions will not be sent
+        for (uint8_t i=0; i<9; i++) {
+            if (!(mask & (1 << i))) continue;
+            if (i == FIELD_SETPOINT) userSettings.setpoint = newSettings->setpoint;
+            else userSettings.*SETTINGS_MEMBER[i] = getValueName(i, value[i]);     // name of map, caller's string may not live on
+            if (_unsentFields & (1 << i)) {
+                _writeStats.coalesced++;
+                HVAC_LOG(HVAC_EV_SETTING_COALESCED, i);
+            }
+            _unsentFields |= (1 << i);
+            _fieldChanged[i] = millis();
+        }
+        // older writes of the same functions will not be confirmed anymore
+        for (uint8_t i=0; i<MAX_PENDING_WRITES; i++) {
+            if ((_writes[i].state == WRITE_PENDING) && (_writes[i].mask & mask)) {
+                _writes[i].mask &= ~mask;
+                if (_writes[i].mask == 0) finishWrite(i, WRITE_SUPERSEDED);
+            }
+        }
+    }
+    uint8_t slot = freeWriteSlot();
+    if (slot == 255) {
+        HVAC_LOG(HVAC_EV_WRITE_NO_SLOT);
+        return HvacWrite();
+    }
+    hvacWriteSlot* write = &_writes[slot];
+    if (++_writeSeq == 0) _writeSeq = 1;    // seq 0 is invalid handle
+    write->seq = _writeSeq;
+    write->state = WRITE_PENDING;
+    write->mask = mask;
+    write->start = millis();
+    write->latency = 0;
+    write->notify = false;
+    for (uint8_t i=0; i<9; i++) {
+        if (mask & (1 << i)) write->value[i] = value[i];
+    }
+    write->timeout = (WRITE_CONFIRM_TIMEOUT * 1000UL) + _coalesceDelay + (count * _pacing.settingsGap);
+    if (!valid) finishWrite(slot, WRITE_REJECTED);
+    return HvacWrite(this, slot, write->seq);
+}
+
+void ToshibaCarrierHvacCore::finishWrite(uint8_t slot, hvacWriteState state) {
+    _writes[slot].state = state;
+    if (state == WRITE_DONE) {
+        uint32_t latency = millis() - _writes[slot].start;
+        _writes[slot].latency = (latency > 0xFFFF) ? 0xFFFF : latency;  // timeout can be longer than 65.5 s
+    }
+    HVAC_LOG(HVAC_EV_WRITE_FINISHED, state);
+    _writes[slot].notify = true;
+}
+
+// field of pending writes is confirmed when a frame of the unit reports the wanted value, always false (nothing changed)
+bool ToshibaCarrierHvacCore::confirmWrites(uint8_t field) {
+    for (uint8_t i=0; i<MAX_PENDING_WRITES; i++) {
+        hvacWriteSlot* write = &_writes[i];
+        if ((write->state != WRITE_PENDING) || !(write->mask & (1 << field))) continue;
+        if (getSettingValue(&currentSettings, field) != write->value[field]) continue;
+        write->mask &= ~(1 << field);
+        if (write->mask == 0) finishWrite(i, WRITE_DONE);
+    }
+    return false;
+}
+
+bool ToshibaCarrierHvacCore::isWriteWaiting(uint8_t field) {
+    for (uint8_t i=0; i<MAX_PENDING_WRITES; i++) {
+        if ((_writes[i].state == WRITE_PENDING) && (_writes[i].mask & (1 << field))) return true;
+    }
+    return false;
+}
+
+void ToshibaCarrierHvacCore::checkWrites(void) {
+    for (uint8_t i=0; i<MAX_PENDING_WRITES; i++) {
+        hvacWriteSlot* write = &_writes[i];
+        if ((write->state == WRITE_PENDING) && ((millis() - write->start) >= write->timeout)) finishWrite(i, WRITE_TIMEOUT);
+    }
+}
+
+void ToshibaCarrierHvacCore::updatePollInterval(void) {
+    bool changed = (currentStatus.roomTemperature != _polledStatus.roomTemperature) ||
+                   (currentStatus.outsideTemperature != _polledStatus.outsideTemperature) ||
+                   (currentStatus.running != _polledStatus.running);
+    if (currentStatus.running && !_polledStatus.running) _cduStartTime = millis();  // cdu just started
+    if (changed || (currentStatus.running && ((millis() - _cduStartTime) < (CDU_START_WINDOW * 1000UL)))) {
+        _pollInterval = _pollMinInterval;
+    } else {    // stable, back off
+        uint32_t limit = _pollMaxInterval;
+        if ((currentSettings.state == OFF_ON_MAP[1]) && ((limit / 2) > _pollMinInterval)) limit /= 2;  // unit on, don't back off too far
+        _pollInterval = ((_pollInterval * 2) < limit) ? (_pollInterval * 2) : limit;
+    }
+    _polledStatus = currentStatus;
+    HVAC_LOG(HVAC_EV_POLL_INTERVAL, _pollInterval / 1000);
+}
+
+void ToshibaCarrierHvacCore::handleHvac(uint32_t maxMicros) {
+    _budgetStart = micros();
+    _budget = maxMicros;
+    _deferred = 0;
+
+    if (_listenOnly) {  // only decode traffic between unit and other device
+        packetMonitor();
+        checkWrites();  // writes from before listen only may still be confirmed
+        return;
+    }
+
+    if (!_connected) {
+        sendHandshake();
+    }
+
+    if (_firstRun) {
+        _connectionTimeout = CONNECTION_TIMEOUT * 60 * 1000;
+        _queryallDelay = START_DELAY * 1000;
+        _firstRun = false;
+    }
+
+    // query all data once after connected, warm start use cached state and query one by one instead
+    if ((((millis() - _lastReceive) >= _queryallDelay) || _warmStart) && !_init && _connected) {
+        if (_warmStart) {
+            HVAC_LOG(HVAC_EV_WARM_START);
+            _revalidateIndex = 0;
+            _warmStart = false;
+        } else queryall();
+        _init = true;
+        _lastPoll = millis();
+        _pollInterval = _pollMinInterval;
+        _polledStatus = currentStatus;
+    }
+    if (_connected) revalidate();
+
+    // missed seconds are sampled before received data changes state, callers sleeping until getNextDeadline() catch up here
+    if (!overBudget(PENDING_SYNC)) sampleHistory();
+
+    packetMonitor();    // process data
+    if (_connected) pumpQueries();
+    if (_probing) checkProbe();
+    checkWrites();
+
+    // state changed, poll faster
+    if (currentSettings.state != _polledState) {
+        _polledState = currentSettings.state;
+        _pollInterval = _pollMinInterval;
+    }
+
+    // adaptive temperature polling, poll early after idle timeout to check the connection
+    bool idle = ((millis() - _lastReceive) >= (IDLE_TIMEOUT * 60 * 1000UL));
+    if ((((millis() - _lastPoll) >= _pollInterval) || idle) && !_sendWake && _init) {
+        HVAC_LOG(HVAC_EV_POLL);
+        _sendWake = true;
+        _pollPending = true;    // interval is updated when the reply is parsed
+        // try to query temperature
+        queryTemperature();
+        _lastSendWake = _lastPoll = millis();
+    }
+
+    // connection timeout
+    if (((millis() - _lastSendWake) >= _connectionTimeout) && _sendWake) {
+        HVAC_LOG(HVAC_EV_CONNECTION_TIMEOUT);
+        resetConnection();
+    }
+
+    // heartbeat when link is idle, link is down after max missed in a row
+    if (_heartbeatInterval && _connected && _init) sendHeartbeat();
+
+    if(_init && ((millis() - _lastSyncSettings) >= _pacing.settingsGap) && !overBudget(PENDING_SYNC)) {
+        uint16_t ready = readySettings();
+        if (ready && hasCommandToken() && syncUserSettings(ready)) {
+            takeCommandToken();     // only when a packet was queued, nothing sent (e.g. clamped setpoint) costs nothing
+            _writeStats.sent++;
+            HVAC_LOG(HVAC_EV_SETTING_SENT);
+        }
+    }
+    // save state to storage
+    if (_storage && _init && ((millis() - _lastCacheCheck) >= (CACHE_WRITE_DELAY * 1000UL)) && !overBudget(PENDING_SYNC)) {
+        _lastCacheCheck = millis();
+        saveCache();
+    }
+
+    // apply schedule entries, clock is read only when next entry is due
+    if (_clock && ((millis() - _lastScheduleCheck) >= _scheduleWait) && !overBudget(PENDING_SYNC)) runSchedule();
+
+    // notify cached state
+    if (_cacheNotify) {
+        _settingsCallbackBucket++;
+        _statusCallbackBucket++;
+        _updateCallbackBucket++;
+        _cacheNotify = false;
+    }
+}
+
+// start again with handshake and query all
+void ToshibaCarrierHvacCore::resetConnection(void) {
+    _firstRun = true;
+    if (_connected) _generation++;
+    _receivedFunctions = _queuedFunctions = _probing = 0;   // running probe is dropped, probed functions stay in use
+    for (uint8_t i=0; i<MAX_QUERY_PIPELINE; i++) _queries[i].function = 0;
+    _revalidatePending = false;
+    _handshakeStep = 0;
+    _handshake = _ready = _connected = _sendWake = _init = _heartbeatPending = _pollPending = false;
+    _heartbeatMissed = 0;
+    _lastReceive = _lastSendWake = millis();
+}
+
+void ToshibaCarrierHvacCore::sendHeartbeat(void) {
+    if (_heartbeatPending) {
+        if ((millis() - _heartbeatSent) < heartbeatTimeout()) return;
+        _heartbeatPending = false;
+        _heartbeatMissed++;
+        _linkStats.lost++;
+        _linkLoss += (25600 - _linkLoss) / 8;
+        HVAC_LOG(HVAC_EV_HEARTBEAT_MISSED, _heartbeatMissed);
+        if (_heartbeatMissed >= _heartbeatMaxMissed) {
+            HVAC_LOG(HVAC_EV_LINK_DOWN, _heartbeatMissed);
+            resetConnection();
+            return;
+        }
+    } else if ((millis() - _lastReceive) < _heartbeatInterval) return;
+    if (getPendingWork() & PENDING_QUERY) return;   // reply of query shows link state too
+    if (sendQuery(HEARTBEAT_FUNCTION)) {
+        _heartbeatPending = true;
+        _heartbeatSent = millis();
+        _linkStats.sent++;
+    }
+}
+
+// smoothed like TCP retransmission timer, first sample sets rtt and half of it as deviation
+void ToshibaCarrierHvacCore::heartbeatReply(void) {
+    _heartbeatPending = false;
+    uint16_t rtt = _lastRxStart - _heartbeatSent;
+    if (!_linkStats.rtt) {
+        _linkStats.rtt = rtt;
+        _linkStats.rttVariance = rtt / 2;
+    } else {
+        uint16_t deviation = (rtt > _linkStats.rtt) ? (rtt - _linkStats.rtt) : (_linkStats.rtt - rtt);
+        _linkStats.rttVariance = ((3UL * _linkStats.rttVariance) + deviation) / 4;
+        _linkStats.rtt = ((7UL * _linkStats.rtt) + rtt) / 8;
+    }
+    _linkLoss -= _linkLoss / 8;
+    HVAC_LOG(HVAC_EV_HEARTBEAT, rtt, _linkStats.rtt);
+}
+
+uint16_t ToshibaCarrierHvacCore::heartbeatTimeout(void) {
+    uint32_t timeout = _linkStats.rtt + (4UL * _linkStats.rttVariance);
+    if (!_linkStats.rtt || (timeout > QUERY_REPLY_TIMEOUT)) return QUERY_REPLY_TIMEOUT;
+    return (timeout < HEARTBEAT_MIN_TIMEOUT) ? HEARTBEAT_MIN_TIMEOUT : timeout;
+}
+
+bool ToshibaCarrierHvacCore::overBudget(uint8_t deferred) {
+    if (!_budget || ((micros() - _budgetStart) < _budget)) return false;
+    _deferred |= deferred;
+    return true;
+}
+
+// unsent fields not changed within coalesce delay, fields already wanted are dropped
+uint16_t ToshibaCarrierHvacCore::readySettings(void) {
+    uint16_t ready = 0;
+    for (uint8_t i=0; i<9; i++) {
+        if (!(_unsentFields & (1 << i))) continue;
+        bool changed = (i == FIELD_SETPOINT) ? (wantedSettings.setpoint != userSettings.setpoint) :
+                       (strcasecmp(wantedSettings.*SETTINGS_MEMBER[i], userSettings.*SETTINGS_MEMBER[i]) != 0);
+        if (!changed) {
+            _unsentFields &= ~(1 << i);
+            _writeStats.dropped++;
+            HVAC_LOG(HVAC_EV_SETTING_DROPPED, i);
+            if (isWriteWaiting(i)) queueQuery(FIELD_FUNCTION[i]);   // unit may have it already, the reply confirms the write
+        } else if ((millis() - _fieldChanged[i]) >= _coalesceDelay) ready |= (1 << i);
+    }
+    return ready;
+}
+
+// token bucket of setting commands, refilled at command rate up to COMMAND_BURST commands
+// refill token bucket, true when a command can be sent now
+bool ToshibaCarrierHvacCore::hasCommandToken(void) {
+    if (!_commandRate) return true;
+    uint32_t cost = 60000UL / _commandRate;
+    uint32_t elapsed = millis() - _lastCommandCredit;
+    _lastCommandCredit = millis();
+    _commandCredit = ((cost * COMMAND_BURST) - _commandCredit > elapsed) ? (_commandCredit + elapsed) : (cost * COMMAND_BURST);
+    if (_commandCredit < cost) {
+        if (!_commandHeld) {
+            _commandHeld = true;
+            _writeStats.throttled++;
+            HVAC_LOG(HVAC_EV_COMMAND_THROTTLED);
+        }
+        return false;
+    }
+    _commandHeld = false;
+    return true;
+}
+
+void ToshibaCarrierHvacCore::takeCommandToken(void) {
+    if (_commandRate) _commandCredit -= 60000UL / _commandRate;
+}
+
+uint8_t ToshibaCarrierHvacCore::getPendingWork(void) {
+    uint8_t pending = _deferred;
+    if (_txLen) pending |= PENDING_TX;
+    if (_queuedFunctions) pending |= PENDING_QUERY;
+    for (uint8_t i=0; i<_queryPipeline; i++) {
+        if (_queries[i].function) pending |= PENDING_QUERY;
+    }
+    return pending;
+}
+
+// ms left of period started at since, 0 when already due
+static uint32_t hvacRemaining(uint32_t since, uint32_t period) {
+    uint32_t elapsed = millis() - since;
+    return (elapsed >= period) ? 0 : (period - elapsed);
+}
+
+// sniffer beside other device (official wifi module), nothing is sent and settings can not be written
+void ToshibaCarrierHvacCore::setListenOnly(bool listenOnly) {
+    if (listenOnly == _listenOnly) return;
+    HVAC_LOG(HVAC_EV_LISTEN_ONLY, listenOnly);
+    _listenOnly = listenOnly;
+    _txLen = 0;             // unsent packets of active mode
+    _unsentFields = 0;
+    resetConnection();      // active mode starts with own handshake
+}
+
+bool ToshibaCarrierHvacCore::isListenOnly(void) {
+    return _listenOnly;
+}
+
+// earliest time any timer of handleHvac expires, received data is not predicted (wait on transport too)
+uint32_t ToshibaCarrierHvacCore::getNextDeadline(void) {
+    if (_deferred) return 0;
+    uint32_t next = 0xFFFFFFFF;
+    #define HVAC_DEADLINE(since, period) do { uint32_t left = hvacRemaining(since, period); if (left < next) next = left; } while (0)
+    if (_rxLen) HVAC_DEADLINE(_lastReceive, RX_READ_TIMEOUT);
+    for (uint8_t i=0; i<MAX_PENDING_WRITES; i++) {
+        if (_writes[i].state == WRITE_PENDING) HVAC_DEADLINE(_writes[i].start, _writes[i].timeout);
+    }
+    if (_listenOnly) return next;
+    if (_firstRun || _cacheNotify) return 0;
+    if (_txLen) HVAC_DEADLINE(millis(), 1);    // transport was full, retry soon
+    if (!_connected) {  // handshake
+        if (_handshakeStep) HVAC_DEADLINE(_lastHandshakeStep, _handshakeWait);
+        else if (_handshake && !_ready) return 0;
+    }
+    if (_sendWake) HVAC_DEADLINE(_lastSendWake, _connectionTimeout);
+    if (_connected) {
+        if (!_init) HVAC_DEADLINE(_lastReceive, _warmStart ? 0 : _queryallDelay);
+        if (_revalidateIndex < sizeof(QUERYALL_FUNCTION)) HVAC_DEADLINE(_lastRevalidate, (_queryPipeline > 1) ? 0 : _pacing.queryGap);
+        bool sendable = _queuedFunctions && nextQuery();     // group functions wait for group reply
+        for (uint8_t i=0; i<_queryPipeline; i++) {
+            if (_queries[i].function) HVAC_DEADLINE(_queries[i].sent, QUERY_REPLY_TIMEOUT);
+            else if (sendable) HVAC_DEADLINE(_lastQuery, (_queryPipeline > 1) ? 0 : _pacing.queryGap);
+        }
+    }
+    if (_heartbeatInterval && _connected && _init) {
+        if (_heartbeatPending) HVAC_DEADLINE(_heartbeatSent, heartbeatTimeout());
+        else if (!(getPendingWork() & PENDING_QUERY)) HVAC_DEADLINE(_lastReceive, _heartbeatInterval);
+    }
+    if (_init) {
+        if (!_sendWake) {
+            HVAC_DEADLINE(_lastPoll, _pollInterval);
+            HVAC_DEADLINE(_lastReceive, IDLE_TIMEOUT * 60 * 1000UL);
+        }
+        if (_unsentFields) {    // field is sent after coalesce delay, settings gap and command token
+            uint32_t wait = hvacRemaining(_lastSyncSettings, _pacing.settingsGap);
+            if (_commandRate) {
+                uint32_t cost = 60000UL / _commandRate;
+                uint32_t credit = _commandCredit + (millis() - _lastCommandCredit);
+                if ((credit < cost) && ((cost - credit) > wait)) wait = cost - credit;
+            }
+            uint32_t coalesce = 0xFFFFFFFF;
+            for (uint8_t i=0; i<9; i++) {
+                if (_unsentFields & (1 << i)) {
+                    uint32_t left = hvacRemaining(_fieldChanged[i], _coalesceDelay);
+                    if (left < coalesce) coalesce = left;
+                }
+            }
+            if (coalesce > wait) wait = coalesce;
+            if (wait < next) next = wait;
+        }
+        if (_storage) HVAC_DEADLINE(_lastCacheCheck, CACHE_WRITE_DELAY * 1000UL);
+    }
+    if (_clock) HVAC_DEADLINE(_lastScheduleCheck, _scheduleWait);
+    #undef HVAC_DEADLINE
+    return next;
+}
+
+// notification
+uint32_t ToshibaCarrierHvacCore::notifyDeadline(uint32_t next, uint8_t bucket, uint32_t last) {
+    if (!bucket) return next;
+    uint32_t left = hvacRemaining(last, (bucket == 1) ? SINGLE_QUEUE_TIMEOUT : MULTI_QUEUE_TIMEOUT);
+    return (left < next) ? left : next;
+}
+
+bool ToshibaCarrierHvacCore::takeNotify(uint8_t* bucket, uint32_t last) {
+    if (((*bucket == 1) && ((millis() - last) >= SINGLE_QUEUE_TIMEOUT)) ||
+        ((*bucket > 1) && ((millis() - last) >= MULTI_QUEUE_TIMEOUT))) {
+        *bucket = 0;
+        return true;
+    }
+    return false;
+}
+
+bool ToshibaCarrierHvacCore::takeLinkNotify(bool* up) {
+    if (_linkUp == _connected) return false;
+    *up = _linkUp = _connected;
+    return true;
+}
+
+bool ToshibaCarrierHvacCore::takeWriteNotify(HvacWrite* write) {
+    for (uint8_t i=0; i<MAX_PENDING_WRITES; i++) {
+        if (_writes[i].notify) {
+            _writes[i].notify = false;
+            *write = HvacWrite(this, i, _writes[i].seq);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* ToshibaCarrierHvacCore::getFunctionName(uint8_t field) {
+    if (field == FIELD_WIFILED) return getNameByByte(FUNCTION_BYTE_MAP, FUNCTION_BYTE, sizeof(FUNCTION_BYTE), _wifiled ? 223 : 222);
+    return getFieldName(field);
+}
+
+bool ToshibaCarrierHvacCore::sendCustomPacket(byte data[], size_t length) {
+    if ((length >= 8) && (length <= 17)) {
+        return sendPacket(data, length);
+    } else {
+        return false;
+    }
+}
+
+HvacWrite ToshibaCarrierHvacCore::applyPreset(hvacSettings newSettings) {
+    uint16_t mask = 0;
+    for (uint8_t i=0; i<9; i++) {   // skip functions not set in preset
+        if ((i == 1) ? (newSettings.setpoint != 0) : (getSettingValue(&newSettings, i) != 255)) mask |= (1 << i);
+    }
+    return createWrite(&newSettings, mask);
+}
+
+HvacWrite ToshibaCarrierHvacCore::setState(const char* newState) {
+    hvacSettings newSettings = userSettings;
+    newSettings.state = newState;
+    return createWrite(&newSettings, 1 << 0);
+}
+
+HvacWrite ToshibaCarrierHvacCore::setSetpoint(uint8_t newSetpoint) {
+    hvacSettings newSettings = userSettings;
+    newSettings.setpoint = newSetpoint;
+    return createWrite(&newSettings, 1 << 1);
+}
+
+HvacWrite ToshibaCarrierHvacCore::setMode(const char* newMode) {
+    hvacSettings newSettings = userSettings;
+    newSettings.mode = newMode;
+    return createWrite(&newSettings, 1 << 2);
+}
+
+#if HVAC_FEATURES & HVAC_FEATURE_SWING
+HvacWrite ToshibaCarrierHvacCore::setSwing(const char* newSwing) {
+    hvacSettings newSettings = userSettings;
+    newSettings.swing = newSwing;
+    return createWrite(&newSettings, 1 << 3);
+}
+#endif
+
+HvacWrite ToshibaCarrierHvacCore::setFanMode(const char* newFanMode) {
+    hvacSettings newSettings = userSettings;
+    newSettings.fanMode = newFanMode;
+    return createWrite(&newSettings, 1 << 4);
+}
+
+#if HVAC_FEATURES & HVAC_FEATURE_PURE
+HvacWrite ToshibaCarrierHvacCore::setPure(const char* newPure) {
+    hvacSettings newSettings = userSettings;
+    newSettings.pure = newPure;
+    return createWrite(&newSettings, 1 << 5);
+}
+#endif
+
+#if HVAC_FEATURES & HVAC_FEATURE_PSEL
+HvacWrite ToshibaCarrierHvacCore::setPowerSelect(const char* newPowerSelect) {
+    hvacSettings newSettings = userSettings;
+    newSettings.powerSelect = newPowerSelect;
+    return createWrite(&newSettings, 1 << 6);
+}
+#endif
+
+#if HVAC_FEATURES & HVAC_FEATURE_OP
+HvacWrite ToshibaCarrierHvacCore::setOperation(const char* newOperation) {
+    hvacSettings newSettings = userSettings;
+    newSettings.operation = newOperation;
+    return createWrite(&newSettings, 1 << 7);
+}
+#endif
+
+#if HVAC_FEATURES & HVAC_FEATURE_WIFILED
+HvacWrite ToshibaCarrierHvacCore::setWifiLed(const char* newWifiLed) {
+    hvacSettings newSettings = userSettings;
+    newSettings.wifiLed = newWifiLed;
+    return createWrite(&newSettings, 1 << 8);
+}
+#endif
+
+hvacStatus ToshibaCarrierHvacCore::getStatus(void) {
+    return currentStatus;
+}
+
+hvacSettings ToshibaCarrierHvacCore::getSettings(void) {
+    return currentSettings;
+}
+
+int8_t ToshibaCarrierHvacCore::getRoomTemperature(void) {
+    return currentStatus.roomTemperature;
+}
+
+int8_t ToshibaCarrierHvacCore::getOutsideTemperature(void) {
+    return currentStatus.outsideTemperature;
+}
+
+const char* ToshibaCarrierHvacCore::getState(void) {
     return currentSettings.state;
 }
 
-uint8_t ToshibaCarrierHvac::getSetpoint(void) {
+uint8_t ToshibaCarrierHvacCore::getSetpoint(void) {
     return currentSettings.setpoint;
 }
 
-const char* ToshibaCarrierHvac::getMode(void) {
+const char* ToshibaCarrierHvacCore::getMode(void) {
     return currentSettings.mode;
 }
 
-const char* ToshibaCarrierHvac::getSwing(void) {
+#if HVAC_FEATURES & HVAC_FEATURE_SWING
+const char* ToshibaCarrierHvacCore::getSwing(void) {
     return currentSettings.swing;
 }
+#endif
 
-const char* ToshibaCarrierHvac::getFanMode(void) {
+const char* ToshibaCarrierHvacCore::getFanMode(void) {
     return currentSettings.fanMode;
 }
 
-const char* ToshibaCarrierHvac::getPure(void) {
+#if HVAC_FEATURES & HVAC_FEATURE_PURE
+const char* ToshibaCarrierHvacCore::getPure(void) {
     return currentSettings.pure;
 }
+#endif
 
-const char* ToshibaCarrierHvac::getOffTimer(void) {
+#if HVAC_FEATURES & HVAC_FEATURE_TIMERS
+const char* ToshibaCarrierHvacCore::getOffTimer(void) {
     return currentStatus.offTimer;
 }
 
-const char* ToshibaCarrierHvac::getOnTimer(void) {
+const char* ToshibaCarrierHvacCore::getOnTimer(void) {
     return currentStatus.onTimer;
 }
+#endif
 
-const char* ToshibaCarrierHvac::getPowerSelect(void) {
+#if HVAC_FEATURES & HVAC_FEATURE_PSEL
+const char* ToshibaCarrierHvacCore::getPowerSelect(void) {
     return currentSettings.powerSelect;
 }
+#endif
 
-const char* ToshibaCarrierHvac::getWifiLed(void) {
+#if HVAC_FEATURES & HVAC_FEATURE_WIFILED
+const char* ToshibaCarrierHvacCore::getWifiLed(void) {
     return currentSettings.wifiLed;
 }
+#endif
 
-const char* ToshibaCarrierHvac::getOperation(void) {
+#if HVAC_FEATURES & HVAC_FEATURE_OP
+const char* ToshibaCarrierHvacCore::getOperation(void) {
     return currentSettings.operation;
 }
+#endif
 
-bool ToshibaCarrierHvac::isCduRunning(void) {
+bool ToshibaCarrierHvacCore::isCduRunning(void) {
     return currentStatus.running;
 }
 
-bool ToshibaCarrierHvac::isConnected(void) {
+bool ToshibaCarrierHvacCore::isConnected(void) {
     return _connected;
 }
 
-void ToshibaCarrierHvac::forceQueryAllData(void) {
+void ToshibaCarrierHvacCore::setPollInterval(uint16_t minInterval, uint16_t maxInterval) {
+    if (minInterval < 1) minInterval = 1;
+    if (maxInterval < minInterval) maxInterval = minInterval;
+    _pollMinInterval = minInterval * 1000UL;
+    _pollMaxInterval = maxInterval * 1000UL;
+    if (_pollInterval < _pollMinInterval) _pollInterval = _pollMinInterval;
+    if (_pollInterval > _pollMaxInterval) _pollInterval = _pollMaxInterval;
+}
+
+uint16_t ToshibaCarrierHvacCore::getPollInterval(void) {
+    return _pollInterval / 1000;
+}
+
+void ToshibaCarrierHvacCore::setPacing(hvacPacing newPacing) {
+    if (newPacing.queryGap == 0) newPacing.queryGap = QUERY_SEND_DELAY;
+    if (newPacing.settingsGap == 0) newPacing.settingsGap = SETTINGS_SEND_DELAY;
+    _pacing = newPacing;
+}
+
+hvacPacing ToshibaCarrierHvacCore::getPacing(void) {
+    return _pacing;
+}
+
+// query every function (again when not answered) and keep only answered ones, older models may reboot on some queries
+// functions are queried through the query queue and kept when answered, pure and wifi led only when risky
+bool ToshibaCarrierHvacCore::probeFunctions(bool risky) {
+    if (!_connected || !_init || _listenOnly || _probing) return false;
+    HVAC_LOG(HVAC_EV_PROBE_START);
+    _supportedFunctions = 0xFFFF;
+    for (uint8_t i=0; i<sizeof(QUERYALL_FUNCTION); i++) {
+        byte function = QUERYALL_FUNCTION[i];
+        if ((HVAC_FEATURES != HVAC_FEATURE_ALL) && !hvacFieldEnabled(getFieldByFunction(function))) continue;   // never queried
+        if (!risky && memchr(PROBE_RISKY_FUNCTION, function, sizeof(PROBE_RISKY_FUNCTION))) {
+            _supportedFunctions &= ~getFunctionBit(function);   // not queried, not used
+            continue;
+        }
+        _probing |= getFunctionBit(function);
+        queueQuery(function);   // group functions wait for group reply
+    }
+    return true;
+}
+
+bool ToshibaCarrierHvacCore::isProbing(void) {
+    return _probing != 0;
+}
+
+// probe is done when no probed function is queued or waiting for reply, queries not answered after retries are not supported
+void ToshibaCarrierHvacCore::checkProbe(void) {
+    uint16_t waiting = _queuedFunctions;
+    for (uint8_t i=0; i<MAX_QUERY_PIPELINE; i++) waiting |= getFunctionBit(_queries[i].function);
+    if (waiting & _probing) return;
+    _supportedFunctions &= ~(_probing & ~_receivedFunctions);
+    uint8_t unsupported = 0;
+    for (uint8_t i=0; i<sizeof(FUNCTION_BYTE); i++) {
+        if (_probing & (1U << i)) HVAC_LOG(HVAC_EV_PROBE_FUNCTION, FUNCTION_BYTE[i], (_receivedFunctions & (1U << i)) != 0);
+        if (!(_supportedFunctions & (1U << i))) unsupported++;
+    }
+    _probing = 0;
+    HVAC_LOG(HVAC_EV_PROBE_DONE, unsupported);
+}
+
+// bit per FUNCTION_BYTE, 0xFFFF = not probed (all functions used)
+void ToshibaCarrierHvacCore::setFunctionProfile(uint16_t profile) {
+    _supportedFunctions = profile;
+}
+
+uint16_t ToshibaCarrierHvacCore::getFunctionProfile(void) {
+    return _supportedFunctions;
+}
+
+bool ToshibaCarrierHvacCore::isSupported(byte function) {
+    uint16_t bit = getFunctionBit(function);
+    return !bit || (_supportedFunctions & bit);
+}
+
+// field answered by unit, true until probed
+bool ToshibaCarrierHvacCore::isFieldSupported(uint8_t field) {
+    if (field == FIELD_WIFILED) return isSupported(222) || isSupported(223);
+    return (field < sizeof(FIELD_FUNCTION)) && isSupported(FIELD_FUNCTION[field]);
+}
+
+void ToshibaCarrierHvacCore::setQueryPipeline(uint8_t depth) {
+    if (depth < 1) depth = 1;
+    if (depth > MAX_QUERY_PIPELINE) depth = MAX_QUERY_PIPELINE;
+    for (uint8_t i=depth; i<MAX_QUERY_PIPELINE; i++) {    // slots no longer used, query again
+        if (_queries[i].function) queueQuery(_queries[i].function);
+        _queries[i].function = 0;
+    }
+    _queryPipeline = depth;
+}
+
+void ToshibaCarrierHvacCore::setCoalesceDelay(uint16_t delay) {
+    _coalesceDelay = delay;
+}
+
+uint16_t ToshibaCarrierHvacCore::getCoalesceDelay(void) {
+    return _coalesceDelay;
+}
+
+void ToshibaCarrierHvacCore::setCommandRate(uint8_t perMinute) {
+    _commandRate = perMinute;
+    _commandCredit = perMinute ? ((60000UL / perMinute) * COMMAND_BURST) : 0;  // start with full burst
+    _lastCommandCredit = millis();
+    _commandHeld = false;
+}
+
+uint8_t ToshibaCarrierHvacCore::getCommandRate(void) {
+    return _commandRate;
+}
+
+// interval(ms) of idle link before heartbeat, 0 = off
+void ToshibaCarrierHvacCore::setHeartbeat(uint16_t interval, uint8_t maxMissed) {
+    _heartbeatInterval = interval;
+    _heartbeatMaxMissed = maxMissed ? maxMissed : 1;
+    _heartbeatPending = false;
+    _heartbeatMissed = 0;
+}
+
+hvacLinkStats ToshibaCarrierHvacCore::getLinkStats(void) {
+    hvacLinkStats stats = _linkStats;
+    stats.loss = (_linkLoss + 128) >> 8;
+    return stats;
+}
+
+void ToshibaCarrierHvacCore::resetLinkStats(void) {
+    _linkStats = hvacLinkStats {};
+    _linkLoss = 0;
+}
+
+hvacWriteStats ToshibaCarrierHvacCore::getWriteStats(void) {
+    return _writeStats;
+}
+
+void ToshibaCarrierHvacCore::resetWriteStats(void) {
+    _writeStats = hvacWriteStats {};
+}
+
+uint8_t ToshibaCarrierHvacCore::getQueryPipeline(void) {
+    return _queryPipeline;
+}
+
+bool ToshibaCarrierHvacCore::setStorage(HvacStorage* storage, uint16_t address) {
+    _storage = storage;
+    _storageAddress = address;
+    _warmStart = _cacheNotify = (_storage && !_init && loadCache());
+    if (_storage) loadSchedule();
+    return _warmStart;
+}
+
+bool ToshibaCarrierHvacCore::isRevalidated(void) {
+    return _init && (_revalidateIndex >= sizeof(QUERYALL_FUNCTION)) && !_revalidatePending;
+}
+
+HvacEventCursor ToshibaCarrierHvacCore::getEventCursor(bool fromOldest) {
+    HvacEventCursor cursor;
+    cursor.seq = _eventSeq;
+    if (fromOldest) cursor.seq = (_eventSeq > EVENT_BUFFER_SIZE) ? (_eventSeq - EVENT_BUFFER_SIZE) : 0;
+    return cursor;
+}
+
+bool ToshibaCarrierHvacCore::readEvent(HvacEventCursor* cursor, hvacEvent* event) {
+    if (cursor->seq == _eventSeq) return false;
+    if ((_eventSeq - cursor->seq) > EVENT_BUFFER_SIZE) {    // fell behind, oldest events were overwritten
+        cursor->missed += (_eventSeq - cursor->seq) - EVENT_BUFFER_SIZE;
+        cursor->seq = _eventSeq - EVENT_BUFFER_SIZE;
+    }
+    *event = _events[cursor->seq % EVENT_BUFFER_SIZE];
+    cursor->seq++;
+    return true;
+}
+
+uint32_t ToshibaCarrierHvacCore::getGeneration(void) {
+    return _generation;
+}
+
+bool ToshibaCarrierHvacCore::changedSince(uint32_t generation) {
+    return generation != _generation;
+}
+
+const char* ToshibaCarrierHvacCore::getFieldName(uint8_t field) {
+    if (field < FIELD_UNKNOWN) return FIELD_MAP[field];
+    return FIELD_MAP[FIELD_UNKNOWN];
+}
+
+const char* ToshibaCarrierHvacCore::getValueName(uint8_t field, int16_t value) {
+    if ((field == FIELD_SETPOINT) || (field == FIELD_ROOMTEMP) || (field == FIELD_OUTSIDETEMP)) return nullptr;  // number
+    if (field == FIELD_CDU_STATE) return OFF_ON_MAP[value ? 1 : 0];
+    #if HVAC_FEATURES & HVAC_FEATURE_WIFILED
+    if (field == FIELD_WIFILED) return getNameByByte(OFF_ON_MAP, WIFILED1_BYTE, sizeof(WIFILED1_BYTE), value);  // saved as wifi led 1 value
+    #endif
+    return getSettingName(field, value);
+}
+
+// history
+void ToshibaCarrierHvacCore::sampleHistory(void) {
+    uint32_t seconds = (millis() - _lastHistorySample) / 1000;
+    if (!seconds) return;
+    if (seconds > HISTORY_MAX_CATCHUP) {
+        _lastHistorySample += (seconds - HISTORY_MAX_CATCHUP) * 1000;
+        seconds = HISTORY_MAX_CATCHUP;
+    }
+    bool valid = _connected && _init;
+    while (seconds--) {     // one sample per second, also seconds spent in blocking queries
+        #if HISTORY_FINE_BUCKETS > 0
+        _historyFine.sample(valid, currentStatus.roomTemperature, currentStatus.outsideTemperature, currentStatus.running);
+        #endif
+        #if HISTORY_COARSE_BUCKETS > 0
+        _historyCoarse.sample(valid, currentStatus.roomTemperature, currentStatus.outsideTemperature, currentStatus.running);
+        #endif
+        _lastHistorySample += 1000;
+        if (seconds && overBudget(PENDING_SYNC)) break;     // catch up on next call
+    }
+}
+
+uint16_t ToshibaCarrierHvacCore::getHistoryLength(hvacHistoryResolution resolution) {
+    #if HISTORY_FINE_BUCKETS > 0
+    if (resolution == HISTORY_FINE) return _historyFine.length();
+    #endif
+    #if HISTORY_COARSE_BUCKETS > 0
+    if (resolution == HISTORY_COARSE) return _historyCoarse.length();
+    #endif
+    return 0;
+}
+
+uint16_t ToshibaCarrierHvacCore::getHistoryMinutes(hvacHistoryResolution resolution) {
+    if (resolution == HISTORY_FINE) return HISTORY_FINE_MINUTES;
+    if (resolution == HISTORY_COARSE) return HISTORY_COARSE_MINUTES;
+    return 0;
+}
+
+bool ToshibaCarrierHvacCore::getHistory(hvacHistoryResolution resolution, uint16_t age, hvacHistoryBucket* bucket) {
+    #if HISTORY_FINE_BUCKETS > 0
+    if (resolution == HISTORY_FINE) return _historyFine.get(age, bucket);
+    #endif
+    #if HISTORY_COARSE_BUCKETS > 0
+    if (resolution == HISTORY_COARSE) return _historyCoarse.get(age, bucket);
+    #endif
+    return false;
+}
+
+uint16_t ToshibaCarrierHvacCore::exportHistory(Print* out, hvacHistoryResolution resolution, uint16_t maxBuckets) {
+    uint16_t count = getHistoryLength(resolution);
+    uint16_t age = 0;
+    #if HISTORY_FINE_BUCKETS > 0
+    if (resolution == HISTORY_FINE) age = _historyFine.age();
+    #endif
+    #if HISTORY_COARSE_BUCKETS > 0
+    if (resolution == HISTORY_COARSE) age = _historyCoarse.age();
+    #endif
+    if (count > maxBuckets) count = maxBuckets;
+    uint8_t minutes = getHistoryMinutes(resolution);
+    uint8_t header[9] = {HVAC_HISTORY_MAGIC[0], HVAC_HISTORY_MAGIC[1], HVAC_HISTORY_MAGIC[2], HVAC_HISTORY_VERSION, minutes,
+                         (uint8_t)count, (uint8_t)(count >> 8), (uint8_t)age, (uint8_t)(age >> 8)};
+    out->write(header, sizeof(header));
+    hvacHistoryBucket bucket;
+    uint8_t data[HVAC_HISTORY_BUCKET_SIZE];
+    for (uint16_t i=count; i>0; i--) {  // oldest first
+        getHistory(resolution, i - 1, &bucket);
+        out->write(data, hvacPackHistoryBucket(&bucket, data));
+    }
+    return count;
+}
+
+#if defined(HVAC_DEBUG)
+void ToshibaCarrierHvacCore::writeLog(uint8_t event, int16_t arg1, int16_t arg2, int16_t arg3) {
+    if (_logCount == LOG_BUFFER_SIZE) {     // keep newest records
+        _logHead = (_logHead + 1) % LOG_BUFFER_SIZE;
+        _logCount--;
+        _logDropped++;
+    }
+    hvacLogRecord* record = &_log[(_logHead + _logCount++) % LOG_BUFFER_SIZE];
+    record->time = micros();
+    record->event = event;
+    record->arg[0] = arg1;
+    record->arg[1] = arg2;
+    record->arg[2] = arg3;
+}
+#endif
+
+void ToshibaCarrierHvacCore::setLogLevel(hvacLogLevel level) {
+    #if defined(HVAC_DEBUG)
+    _logLevel = level;
+    #endif
+}
+
+hvacLogLevel ToshibaCarrierHvacCore::getLogLevel(void) {
+    #if defined(HVAC_DEBUG)
+    return (hvacLogLevel)_logLevel;
+    #else
+    return HVAC_LOG_NONE;
+    #endif
+}
+
+bool ToshibaCarrierHvacCore::readLog(hvacLogRecord* record) {
+    #if defined(HVAC_DEBUG)
+    if (!_logCount) return false;
+    *record = _log[_logHead];
+    _logHead = (_logHead + 1) % LOG_BUFFER_SIZE;
+    _logCount--;
+    return true;
+    #else
+    return false;
+    #endif
+}
+
+uint16_t ToshibaCarrierHvacCore::printLog(Print* out) {
+    uint16_t count = 0;
+    hvacLogRecord record;
+    char text[96];
+    while (readLog(&record)) {
+        hvacFormatLogRecord(text, sizeof(text), &record, FIELD_MAP, sizeof(FIELD_MAP) / sizeof(FIELD_MAP[0]));
+        out->print(F("HVAC> "));
+        out->print(record.time);
+        out->print(" ");
+        out->print(hvacLogLevelName(hvacLogLevelOf(record.event)));
+        out->print(" ");
+        out->println(text);
+        count++;
+    }
+    return count;
+}
+
+uint16_t ToshibaCarrierHvacCore::dumpLog(Print* out) {
+    uint16_t dropped = getLogDropped();
+    uint8_t header[6] = {HVAC_LOG_MAGIC[0], HVAC_LOG_MAGIC[1], HVAC_LOG_MAGIC[2], HVAC_LOG_VERSION, (uint8_t)dropped, (uint8_t)(dropped >> 8)};
+    out->write(header, sizeof(header));
+    uint16_t count = 0;
+    hvacLogRecord record;
+    uint8_t data[HVAC_LOG_RECORD_SIZE];
+    while (readLog(&record)) {
+        out->write(data, hvacPackLogRecord(&record, data));
+        count++;
+    }
+    return count;
+}
+
+uint16_t ToshibaCarrierHvacCore::getLogDropped(void) {
+    #if defined(HVAC_DEBUG)
+    return _logDropped;
+    #else
+    return 0;
+    #endif
+}
+
+void ToshibaCarrierHvacCore::setClock(HvacClock* clock) {
+    _clock = clock;
+    _scheduleValid = false;
+    _scheduleWait = 0;
+}
+
+int8_t ToshibaCarrierHvacCore::addSchedule(uint8_t days, uint8_t hour, uint8_t minute, hvacSettings preset) {
+    hvacScheduleEntry entry;
+    if ((hour > 23) || (minute > 59)) return -1;
+    entry.minute = (hour * 60) + minute;
+    entry.days = days;
+    for (uint8_t i=0; i<9; i++) {   // skip functions not set in preset like applyPreset, reject unknown names
+        if (i == FIELD_SETPOINT) entry.settings[i] = preset.setpoint ? getSettingValue(&preset, i) : 255;
+        else if (!hvacFieldEnabled(i) || (preset.*SETTINGS_MEMBER[i] == nullptr)) entry.settings[i] = 255;
+        else if ((entry.settings[i] = getSettingValue(&preset, i)) == 255) return -1;
+    }
+    int8_t slot = _schedule.add(&entry);
+    if (slot >= 0) {
+        saveSchedule();
+        _scheduleWait = 0;  // next entry may be earlier
+    }
+    return slot;
+}
+
+bool ToshibaCarrierHvacCore::getSchedule(uint8_t slot, uint8_t* days, uint8_t* hour, uint8_t* minute, hvacSettings* preset) {
+    hvacScheduleEntry entry;
+    if (!_schedule.get(slot, &entry)) return false;
+    *days = entry.days;
+    *hour = entry.minute / 60;
+    *minute = entry.minute % 60;
+    *preset = hvacSettings {};
+    for (uint8_t i=0; i<9; i++) {
+        if (entry.settings[i] == 255) continue;
+        if (i == FIELD_SETPOINT) preset->setpoint = entry.settings[i];
+        else preset->*SETTINGS_MEMBER[i] = getValueName(i, entry.settings[i]);   // wifi led saved as wifi led 1 value
+    }
+    return true;
+}
+
+bool ToshibaCarrierHvacCore::removeSchedule(uint8_t slot) {
+    if (!_schedule.remove(slot)) return false;
+    saveSchedule();
+    _scheduleWait = 0;
+    return true;
+}
+
+void ToshibaCarrierHvacCore::clearSchedule(void) {
+    _schedule.clear();
+    saveSchedule();
+}
+
+// seconds until next schedule entry, 0 when schedule is empty or time is not known
+uint32_t ToshibaCarrierHvacCore::getNextSchedule(void) {
+    uint32_t now;
+    if (!_clock || !_clock->secondOfWeek(&now)) return 0;
+    return _schedule.next(now);
+}
+
+void ToshibaCarrierHvacCore::runSchedule(void) {
+    uint32_t now;
+    _lastScheduleCheck = millis();
+    if (!_clock->secondOfWeek(&now)) {
+        _scheduleValid = false;
+        _scheduleWait = SCHEDULE_CLOCK_RETRY * 1000UL;
+        return;
+    }
+    now %= HVAC_SECONDS_PER_WEEK;
+    // apply entries due since last check in order, skipped after clock jump
+    if (_scheduleValid && (((now + HVAC_SECONDS_PER_WEEK - _scheduleLast) % HVAC_SECONDS_PER_WEEK) <= SCHEDULE_MAX_LATE)) {
+        uint8_t slots[SCHEDULE_SIZE];
+        uint8_t count = _schedule.due(_scheduleLast, now, slots);
+        for (uint8_t i=0; i<count; i++) applySchedule(slots[i]);
+    }
+    _scheduleLast = now;
+    _scheduleValid = true;
+    uint32_t wait = _schedule.next(now);
+    if (!wait || (wait > SCHEDULE_MAX_SLEEP)) wait = SCHEDULE_MAX_SLEEP;
+    _scheduleWait = wait * 1000UL;
+}
+
+// write functions set in entry, other functions keep wanted value like setters
+void ToshibaCarrierHvacCore::applySchedule(uint8_t slot) {
+    hvacScheduleEntry* entry = &_schedule.entries()[slot];
+    hvacSettings newSettings = userSettings;
+    uint16_t mask = 0;
+    for (uint8_t i=0; i<9; i++) {
+        if (entry->settings[i] == 255) continue;
+        if (i == FIELD_SETPOINT) newSettings.setpoint = entry->settings[i];
+        else newSettings.*SETTINGS_MEMBER[i] = getValueName(i, entry->settings[i]);
+        mask |= (1 << i);
+    }
+    HVAC_LOG(HVAC_EV_SCHEDULE, slot, entry->minute / 60, entry->minute % 60);
+    if (mask) createWrite(&newSettings, mask);
+}
+
+// schedule is saved after cached state at next multiple of 4 (RTC memory is read in 32 bit blocks): magic, entries, checksum
+#define SCHEDULE_STORAGE_OFFSET (((sizeof(hvacCache) + 3) / 4) * 4)
+
+bool ToshibaCarrierHvacCore::loadSchedule(void) {
+    uint8_t data[sizeof(hvacScheduleEntry) * SCHEDULE_SIZE + 2];
+    if (!_storage->read(_storageAddress + SCHEDULE_STORAGE_OFFSET, data, sizeof(data))) return false;
+    uint8_t sum = 0;
+    for (uint16_t i=0; i<sizeof(data); i++) sum += data[i];
+    if ((data[0] != SCHEDULE_MAGIC) || (sum != 0)) return false;
+    memcpy(_schedule.entries(), data + 1, sizeof(hvacScheduleEntry) * SCHEDULE_SIZE);
+    _scheduleWait = 0;
+    return true;
+}
+
+bool ToshibaCarrierHvacCore::saveSchedule(void) {
+    if (!_storage) return false;
+    uint8_t data[sizeof(hvacScheduleEntry) * SCHEDULE_SIZE + 2];
+    data[0] = SCHEDULE_MAGIC;
+    memcpy(data + 1, _schedule.entries(), sizeof(hvacScheduleEntry) * SCHEDULE_SIZE);
+    uint8_t sum = 0;
+    for (uint16_t i=0; i<(sizeof(data) - 1); i++) sum += data[i];
+    data[sizeof(data) - 1] = 0 - sum;
+    return _storage->write(_storageAddress + SCHEDULE_STORAGE_OFFSET, data, sizeof(data));
+}
+
+bool ToshibaCarrierHvacCore::getProfile(hvacProfileStage stage, hvacProfileStats* stats) {
+    #if defined(HVAC_PROFILE)
+    return _profiler.get(stage, stats);
+    #else
+    return false;
+    #endif
+}
+
+void ToshibaCarrierHvacCore::resetProfile(void) {
+    #if defined(HVAC_PROFILE)
+    _profiler.reset();
+    #endif
+}
+
+// one line per stage: name, calls, min, avg, max (us) and histogram bins
+void ToshibaCarrierHvacCore::printProfile(Print* out) {
+    hvacProfileStats stats;
+    for (uint8_t stage=0; getProfile((hvacProfileStage)stage, &stats); stage++) {
+        out->print(F("HVAC> "));
+        out->print(hvacProfileStageName(stage));
+        out->print(F(" n="));
+        out->print(stats.count);
+        out->print(F(" min="));
+        out->print(stats.min);
+        out->print(F(" avg="));
+        out->print(stats.count ? (uint32_t)(stats.total / stats.count) : 0);
+        out->print(F(" max="));
+        out->print(stats.max);
+        out->print(F(" hist="));
+        for (uint8_t i=0; i<HVAC_PROFILE_BINS; i++) {
+            if (i) out->print(",");
+            out->print(stats.histogram[i]);
+        }
+        out->println();
+    }
+}
+
+void ToshibaCarrierHvacCore::forceQueryAllData(void) {
     _init = false;
+    _receivedFunctions = 0;
 }
\ No newline at end of file
@@ -7,6 +7,28 @@
     #include "WProgram.h"
 #endif
 
+#include "HvacStorage.h"
+#include "HvacTransport.h"
+#include "HvacLog.h"
+#include "HvacHistory.h"
+#include "HvacProfile.h"
+#include "HvacSchedule.h"
+#include "HvacEventLoop.h"
+
+// functions compiled in, state, setpoint, mode, fan mode, room/outside temperature and CDU state are always in.
+// Remove functions you don't use to save flash and RAM on small targets (tables, decoder, sync, setters and getters are removed),
+// e.g. #define HVAC_FEATURES (HVAC_FEATURE_ALL & ~(HVAC_FEATURE_SWING | HVAC_FEATURE_OP))
+#define HVAC_FEATURE_SWING 1
+#define HVAC_FEATURE_PURE 2
+#define HVAC_FEATURE_PSEL 4
+#define HVAC_FEATURE_OP 8
+#define HVAC_FEATURE_WIFILED 16
+#define HVAC_FEATURE_TIMERS 32
+#define HVAC_FEATURE_ALL 63
+#if !defined(HVAC_FEATURES)
+    #define HVAC_FEATURES HVAC_FEATURE_ALL
+#endif
+
 // hardware serial or software serial
 // #define HVAC_USE_HW_SERIAL
 #if !defined(HVAC_USE_HW_SERIAL) && (defined(__AVR__) || defined(ESP8266))
@@ -17,22 +39,125 @@
 // software serial for AVR
 #if defined(HVAC_USE_SW_SERIAL) && defined(__AVR__)
     #include <CustomSoftwareSerial.h>
-    // #define HVAC_DEBUG
+    typedef CustomSoftwareSerial HvacSoftwareSerial;
 #endif
 
 // software serial for ESP8266
 #if defined(HVAC_USE_SW_SERIAL) && (defined(ESP8266))
     #include <SoftwareSerial.h>
-    // #define HVAC_DEBUG
+    typedef SoftwareSerial HvacSoftwareSerial;
+#endif
+
+// debug log kept in RAM, read it with printLog(), dumpLog() or readLog()
+// #define HVAC_DEBUG
+
+// log records kept until read
+#if !defined(LOG_BUFFER_SIZE)
+    #if defined(__AVR__)
+        #define LOG_BUFFER_SIZE 16
+    #else
+        #define LOG_BUFFER_SIZE 64
+    #endif
+#endif
+
+// time spent in handleHvac and its stages, read it with getProfile() or printProfile()
+// #define HVAC_PROFILE
+
+// profiler time source, name of your own uint32_t function (e.g. cycle counter) to profile in other units than us, default micros
+// #define HVAC_PROFILE_CLOCK myClock
+
+// longest packet accepted from hvac, longer packets are dropped
+#if !defined(RX_FRAME_BUFFER_SIZE)
+    #define RX_FRAME_BUFFER_SIZE 64
+#endif
+
+// packets waiting for transport, write never waits for transport
+#if !defined(TX_BUFFER_SIZE)
+    #define TX_BUFFER_SIZE 64
+#endif
+
+// temperature and CDU duty history, number of buckets and minutes per bucket, 0 buckets disables a resolution
+// opt-in, RAM per instance is 8 bytes per bucket (360 fine buckets for 6 hours and 672 coarse buckets for 7 days take 8.2 kB)
+#if !defined(HISTORY_FINE_BUCKETS)
+    #define HISTORY_FINE_BUCKETS 0
+#endif
+#if !defined(HISTORY_FINE_MINUTES)
+    #define HISTORY_FINE_MINUTES 1
+#endif
+#if !defined(HISTORY_COARSE_BUCKETS)
+    #define HISTORY_COARSE_BUCKETS 0
+#endif
+#if !defined(HISTORY_COARSE_MINUTES)
+    #define HISTORY_COARSE_MINUTES 15
+#endif
+
+// schedule entries kept on device
+#if !defined(SCHEDULE_SIZE)
+    #if defined(__AVR__)
+        #define SCHEDULE_SIZE 4
+    #else
+        #define SCHEDULE_SIZE 16
+    #endif
 #endif
 
-// show error about debug port
-#if defined(HVAC_DEBUG) && !defined(ESP32) && !defined(HVAC_USE_SW_SERIAL)
-    #error "Debug enabled but hardware serial also used"
+// heartbeats missed in a row before link is down
+#if !defined(HEARTBEAT_MAX_MISSED)
+    #define HEARTBEAT_MAX_MISSED 3
+#endif
+
+// max writes tracked at the same time
+#if !defined(MAX_PENDING_WRITES)
+    #define MAX_PENDING_WRITES 4
+#endif
+
+// profiler stage of a scope, switched back when scope ends
+#if defined(HVAC_PROFILE)
+#if defined(HVAC_PROFILE_CLOCK)
+uint32_t HVAC_PROFILE_CLOCK(void);
+#else
+    #define HVAC_PROFILE_CLOCK micros
+#endif
+
+class HvacProfileScope {
+    private:
+        HvacProfiler* _profiler;
+        uint8_t _previous;
+
+    public:
+        HvacProfileScope(HvacProfiler* profiler, uint8_t stage) : _profiler(profiler), _previous(profiler->enter(stage, HVAC_PROFILE_CLOCK())) {}
+        ~HvacProfileScope() { _profiler->enter(_previous, HVAC_PROFILE_CLOCK()); }
+};
+
+// one handleHvac call
+class HvacProfileCall {
+    private:
+        HvacProfiler* _profiler;
+
+    public:
+        HvacProfileCall(HvacProfiler* profiler) : _profiler(profiler) { profiler->begin(HVAC_PROFILE_CLOCK()); }
+        ~HvacProfileCall() { _profiler->end(HVAC_PROFILE_CLOCK()); }
+};
+
+    #define HVAC_PROFILE_SCOPE(stage) HvacProfileScope hvacProfileScope(&_profiler, stage)
+    #define HVAC_PROFILE_CALL() HvacProfileCall hvacProfileCall(&_profiler)
 #else
-    #define DEBUG_PORT Serial
+    #define HVAC_PROFILE_SCOPE(stage) do {} while (0)
+    #define HVAC_PROFILE_CALL() do {} while (0)
 #endif
 
+// max queries outstanding in pipelined query mode
+#if !defined(MAX_QUERY_PIPELINE)
+    #define MAX_QUERY_PIPELINE 4
+#endif
+
+// change events kept for event cursors
+#if !defined(EVENT_BUFFER_SIZE)
+    #if defined(__AVR__)
+        #define EVENT_BUFFER_SIZE 8
+    #else
+        #define EVENT_BUFFER_SIZE 32
+    #endif
+#endif
 
 // callback
 #if defined(ESP8266) || defined(ESP32)
@@ -41,11 +166,17 @@
     #define SETTINGS_UPDATED_CALLBACK_SIGNATURE std::function<void(hvacSettings newSettings)> settingsUpdatedCallback
     #define UPDATE_CALLBACK_SIGNATURE std::function<void(void)> updateCallback
     #define WHICH_FUNCTION_UPDATED_CALLBACK_SIGNATURE std::function<void(const char* function)> whichFunctionUpdatedCallback
+    #define WRITE_COMPLETED_CALLBACK_SIGNATURE std::function<void(HvacWrite write)> writeCompletedCallback
+    #define LINK_CHANGED_CALLBACK_SIGNATURE std::function<void(bool connected)> linkChangedCallback
+    #define FRAME_RECEIVED_CALLBACK_SIGNATURE std::function<void(hvacFrame frame)> frameReceivedCallback
 #else
     #define STATUS_UPDATED_CALLBACK_SIGNATURE void (*statusUpdatedCallback)(hvacStatus newStatus)
     #define SETTINGS_UPDATED_CALLBACK_SIGNATURE void (*settingsUpdatedCallback)(hvacSettings newSettings)
     #define UPDATE_CALLBACK_SIGNATURE void (*updateCallback)(void)
     #define WHICH_FUNCTION_UPDATED_CALLBACK_SIGNATURE void (*whichFunctionUpdatedCallback)(const char* function)
+    #define WRITE_COMPLETED_CALLBACK_SIGNATURE void (*writeCompletedCallback)(HvacWrite write)
+    #define LINK_CHANGED_CALLBACK_SIGNATURE void (*linkChangedCallback)(bool connected)
+    #define FRAME_RECEIVED_CALLBACK_SIGNATURE void (*frameReceivedCallback)(hvacFrame frame)
 #endif
 
 // hvac settings structure
@@ -70,10 +201,186 @@ struct hvacStatus {
     bool running;
 };
 
-class ToshibaCarrierHvac {
+// command pacing structure
+struct hvacPacing {
+    uint16_t queryGap;      // delay(ms) between queries
+    uint16_t settingsGap;   // delay(ms) between settings
+    uint16_t latency;       // measured response latency(ms), 0 = not calibrated
+};
+
+// setting command statistics
+struct hvacWriteStats {
+    uint32_t sent;          // setting commands sent to the unit
+    uint32_t coalesced;     // values replaced by a newer value before sent
+    uint32_t dropped;       // values not sent because the unit already has it (set back or changed by remote)
+    uint32_t throttled;     // commands delayed by command rate limit
+};
+
+// heartbeat link quality
+struct hvacLinkStats {
+    uint16_t rtt;           // smoothed round trip time of heartbeat (ms)
+    uint16_t rttVariance;   // smoothed deviation of round trip time (ms)
+    uint32_t sent;          // heartbeats sent
+    uint32_t lost;          // heartbeats not answered in time
+    uint8_t loss;           // recent loss rate (%)
+};
+
+// cached state structure, settings and timers are saved as index of name map
+struct hvacCache {
+    uint8_t magic;
+    uint8_t settings[9];    // state, setpoint, mode, swing, fanMode, pure, powerSelect, operation, wifiLed
+    uint8_t wifiLedFn;      // wifi led 1 or 2
+    hvacPacing pacing;
+    uint16_t functions;     // function profile
+    int8_t roomTemperature;
+    int8_t outsideTemperature;
+    uint8_t timers[2];      // offTimer, onTimer
+    uint8_t running;
+    uint8_t checksum;
+};
+
+// field of settings and status, same order as hvacSettings
+enum hvacField {
+    FIELD_STATE,
+    FIELD_SETPOINT,
+    FIELD_MODE,
+    FIELD_SWING,
+    FIELD_FANMODE,
+    FIELD_PURE,
+    FIELD_PSEL,
+    FIELD_OP,
+    FIELD_WIFILED,
+    FIELD_ROOMTEMP,
+    FIELD_OUTSIDETEMP,
+    FIELD_OFFTIMER,
+    FIELD_ONTIMER,
+    FIELD_CDU_STATE,
+    FIELD_UNKNOWN
+};
+
+// field compiled in by HVAC_FEATURES
+constexpr bool hvacFieldEnabled(uint8_t field) {
+    return !(((field == FIELD_SWING) && !(HVAC_FEATURES & HVAC_FEATURE_SWING)) ||
+             ((field == FIELD_PURE) && !(HVAC_FEATURES & HVAC_FEATURE_PURE)) ||
+             ((field == FIELD_PSEL) && !(HVAC_FEATURES & HVAC_FEATURE_PSEL)) ||
+             ((field == FIELD_OP) && !(HVAC_FEATURES & HVAC_FEATURE_OP)) ||
+             ((field == FIELD_WIFILED) && !(HVAC_FEATURES & HVAC_FEATURE_WIFILED)) ||
+             (((field == FIELD_OFFTIMER) || (field == FIELD_ONTIMER)) && !(HVAC_FEATURES & HVAC_FEATURE_TIMERS)));
+}
+
+// change event, value is byte value of function (wifi led as wifi led 1), setpoint and temperature as number, cdu state as 0 or 1
+struct hvacEvent {
+    uint32_t time;      // millis() when decoded
+    uint8_t field;
+    int16_t oldValue;
+    int16_t newValue;
+};
+
+// received frame passed to onFrame before decoding, pointers are into receive buffer and valid only during callback
+struct hvacFrame {
+    uint32_t time;              // millis() at first byte
+    const uint8_t* data;        // whole frame, header to checksum
+    uint8_t length;
+    uint8_t type;               // 16 command, 17 feedback, 128 syn/ack, 130 ack, 144 reply
+    uint8_t counter;            // feedback count of feedback frames
+    const uint8_t* payload;     // function and values of command, feedback and reply frames, nullptr otherwise
+    uint8_t payloadLength;
+    bool checksum;              // checksum matches, frames with wrong checksum are tapped but not decoded
+};
+
+// read position of an event consumer
+struct HvacEventCursor {
+    uint32_t seq = 0;
+    uint32_t missed = 0;    // events overwritten before read, consumer fell behind
+};
+
+// write confirmation state
+enum hvacWriteState {
+    WRITE_INVALID,      // handle not valid or slot reused
+    WRITE_PENDING,      // waiting for the unit
+    WRITE_DONE,         // confirmed by the unit
+    WRITE_TIMEOUT,      // no confirmation in time
+    WRITE_REJECTED,     // invalid value, not sent
+    WRITE_SUPERSEDED    // all functions overwritten by a newer write
+};
+
+// outstanding query in pipelined mode, function 0 = free
+struct hvacQuerySlot {
+    byte function;
+    uint8_t retries;
+    uint32_t sent;
+};
+
+// work left after handleHvac, bit mask returned by getPendingWork()
+enum hvacPendingWork {
+    PENDING_RX = 1,         // received packets not decoded yet
+    PENDING_TX = 2,         // packets waiting for transport
+    PENDING_QUERY = 4,      // queries queued or waiting for reply
+    PENDING_SYNC = 8,       // settings sync, storage or history deferred by time budget
+    PENDING_NOTIFY = 16     // callbacks deferred by time budget
+};
+
+// write slot, settings are saved as byte value of each function
+struct hvacWriteSlot {
+    uint16_t mask;          // functions waiting for confirmation, bit index same as hvacSettings
+    uint8_t value[9];       // wanted value
+    uint8_t seq;
+    uint8_t state;
+    bool notify;            // finished but not notified yet
+    uint32_t start;
+    uint32_t timeout;
+    uint16_t latency;
+};
+
+class ToshibaCarrierHvacCore;
+
+// handle returned by setters, no heap allocation. Valid until its slot is reused by another write
+class HvacWrite {
+    private:
+        ToshibaCarrierHvacCore* _hvac = nullptr;
+        uint8_t _slot = 0;
+        uint8_t _seq = 0;
+        friend class ToshibaCarrierHvacCore;
+        HvacWrite(ToshibaCarrierHvacCore* hvac, uint8_t slot, uint8_t seq) : _hvac(hvac), _slot(slot), _seq(seq) {}
+
+    public:
+        HvacWrite() {}
+        hvacWriteState state(void) const;
+        bool isPending(void) const { return state() == WRITE_PENDING; }
+        bool isDone(void) const { return state() == WRITE_DONE; }
+        bool isFailed(void) const { return (state() != WRITE_PENDING) && (state() != WRITE_DONE); }
+        uint16_t latency(void) const;   // ms from setter called until confirmed
+};
+
+// prebuilt packets are kept in flash on AVR
+#if defined(__AVR__)
+    #define HVAC_PROGMEM PROGMEM
+    #define HVAC_READ_PACKET_BYTE(address) pgm_read_byte(address)
+#else
+    #define HVAC_PROGMEM
+    #define HVAC_READ_PACKET_BYTE(address) (*(address))
+#endif
+
+// packet checksum, 0 minus sum of all bytes except first byte and checksum
+constexpr byte hvacChecksum(const byte packet[], size_t length, size_t i = 1, uint16_t sum = 0) {
+    return (i >= (length - 1)) ? (byte)(0 - sum) : hvacChecksum(packet, length, i + 1, sum + packet[i]);
+}
+
+constexpr bool hvacChecksumValid(const byte packet[], size_t length) {
+    return hvacChecksum(packet, length) == packet[length - 1];
+}
+
+// COMMAND packet querying 1 function
+#define HVAC_QUERY_PACKET(function) {2, 0, 3, 16, 0, 0, 6, 1, 48, 1, 0, 1, function, (byte)(0 - (3 + 16 + 6 + 1 + 48 + 1 + 1 + function))}
+
+constexpr bool hvacQueryPacketsValid(const byte packets[][14], size_t count) {
+    return (count == 0) || ((packets[0][3] == 16) && ((packets[0][6] + 8) == 14) && (packets[0][11] == 1) && hvacChecksumValid(packets[0], 14) &&
+                            hvacQueryPacketsValid(packets + 1, count - 1));
+}
+
+// protocol, settings and status without notification, use ToshibaCarrierHvacT or ToshibaCarrierHvac
+class ToshibaCarrierHvacCore {
     private:
-        Stream* _serial;
-        bool _swSerial;
         bool _firstRun = true;
         bool _handshake = false; // waiting
         bool _ready = false;     // waiting
@@ -83,39 +390,147 @@ class ToshibaCarrierHvac {
         bool _wifiled = false;  // wifi LED 1 or 2
         uint32_t _lastReceive = 0;
         uint32_t _lastSendWake = 0;
-        uint32_t _idleTimeout = 0;
+        uint32_t _lastPoll = 0;
+        uint32_t _pollInterval = 0;
+        uint32_t _pollMinInterval = 0;
+        uint32_t _pollMaxInterval = 0;
+        uint32_t _cduStartTime = 0;
+        uint32_t _lastRxStart = 0;
+        byte _rxBuffer[RX_FRAME_BUFFER_SIZE];
+        uint8_t _rxLen = 0;
+        byte _txBuffer[TX_BUFFER_SIZE];
+        uint8_t _txHead = 0;
+        uint8_t _txLen = 0;
+        uint32_t _lastReplyTime = 0;
+        byte _calibrateReply[2] = {};       // functions of replies waited for by pacing calibration, 0 = received
+        bool _calibrateWrite = false;       // waiting for setting changed replies
+        hvacPacing _pacing {};
+        HvacStorage* _storage = nullptr;
+        uint16_t _storageAddress = 0;
+        hvacCache _savedCache {};
+        bool _warmStart = false;        // cached state loaded, skip start delay and query all
+        bool _cacheNotify = false;      // do a callback with cached state
+        uint8_t _handshakeStep = 0;     // next handshake packet, 0 = idle
+        uint8_t _handshakeWait = 0;     // delay(ms) after last handshake packet
+        uint32_t _lastHandshakeStep = 0;
+        uint8_t _revalidateIndex = 255; // next function to query after warm start
+        uint16_t _receivedFunctions = 0;    // bit per FUNCTION_BYTE decoded since bootstrap started
+        uint16_t _supportedFunctions = 0xFFFF;  // bit per FUNCTION_BYTE answered by unit, all until probed
+        uint16_t _probing = 0;                  // bit per FUNCTION_BYTE queried by running probe
+        bool _revalidatePending = false;    // pipelined revalidation queued but not answered yet
+        uint32_t _lastRevalidate = 0;
+        uint32_t _lastCacheCheck = 0;
         uint32_t _connectionTimeout = 0;
         uint32_t _queryallDelay = 0;
         uint32_t _lastSyncSettings = 0;
-        uint32_t _lastSettingsCallback = 0;
-        uint32_t _lastStatusCallback = 0;
-        uint32_t _lastUpdateCallback = 0;
-        uint8_t _settingsCallbackBucket = 0;
-        uint8_t _statusCallbackBucket = 0;
-        uint8_t _updateCallbackBucket = 0;
+        uint16_t _unsentFields = 0;         // bit per field set by user but not sent yet
+        uint32_t _fieldChanged[9] {};       // time field was set by user
+        uint16_t _coalesceDelay = 0;        // send field after not changed for x ms
+        uint8_t _commandRate = 0;           // max setting commands per minute, 0 = no limit
+        uint32_t _commandCredit = 0;        // token bucket in ms, one command costs 60000 / _commandRate
+        uint32_t _lastCommandCredit = 0;
+        bool _commandHeld = false;          // ready command waits for rate limit
+        hvacWriteStats _writeStats {};
+        bool _listenOnly = false;           // sniffer, decode received frames and never transmit
+        uint16_t _heartbeatInterval = 0;    // send heartbeat after link idle for x ms, 0 = off
+        uint8_t _heartbeatMaxMissed = 0;
+        uint8_t _heartbeatMissed = 0;       // in a row
+        bool _heartbeatPending = false;
+        uint32_t _heartbeatSent = 0;
+        uint16_t _linkLoss = 0;             // smoothed loss rate in 1/256 %
+        hvacLinkStats _linkStats {};
+        bool _linkUp = false;               // connection state last notified
 
         hvacSettings currentSettings {};
         hvacSettings wantedSettings {"UNKNOWN", 0, "UNKNOWN", "UNKNOWN", "UNKNOWN", "UNKNOWN", "UNKNOWN", "UNKNOWN", "UNKNOWN"}; // set data to prevent strcasecmp crash
         hvacSettings userSettings {"UNKNOWN", 0, "UNKNOWN", "UNKNOWN", "UNKNOWN", "UNKNOWN", "UNKNOWN", "UNKNOWN", "UNKNOWN"};   // set data to prevent strcasecmp crash
         hvacStatus currentStatus {};
+        hvacStatus _polledStatus {};        // status at last poll reply
+        const char* _polledState = nullptr; // state at last temperature query
+        bool _pollPending = false;          // poll sent, interval not updated yet
 
-        // callback
-        STATUS_UPDATED_CALLBACK_SIGNATURE {nullptr};
-        SETTINGS_UPDATED_CALLBACK_SIGNATURE {nullptr};
-        UPDATE_CALLBACK_SIGNATURE {nullptr};
-        WHICH_FUNCTION_UPDATED_CALLBACK_SIGNATURE {nullptr};
+        // confirmed writes
+        hvacWriteSlot _writes[MAX_PENDING_WRITES] {};
+        uint8_t _writeSeq = 0;
+        friend class HvacWrite;
+
+        // pipelined queries
+        hvacQuerySlot _queries[MAX_QUERY_PIPELINE] {};
+        uint8_t _queryPipeline = 1;     // 1 = one query at a time with query delay
+        uint16_t _queuedFunctions = 0;  // bit per FUNCTION_BYTE waiting for a free query slot
+        uint32_t _lastQuery = 0;
+
+        // time budget of current handleHvac call
+        uint32_t _budgetStart = 0;
+        uint32_t _budget = 0;           // micros, 0 = unlimited
+        uint8_t _deferred = 0;          // hvacPendingWork deferred by budget in last call
+
+        // change events
+        hvacEvent _events[EVENT_BUFFER_SIZE] {};
+        uint32_t _eventSeq = 0;
+        uint32_t _generation = 0;   // bumped on every visible state change (decoded change, connection, cache load)
+
+        // schedule
+        HvacSchedule<SCHEDULE_SIZE> _schedule;
+        HvacClock* _clock = nullptr;
+        uint32_t _lastScheduleCheck = 0;
+        uint32_t _scheduleWait = 0;     // ms until next check
+        uint32_t _scheduleLast = 0;     // second of week of last check
+        bool _scheduleValid = false;    // _scheduleLast is known
+
+        // history
+        #if HISTORY_FINE_BUCKETS > 0
+        HvacHistoryLevel<HISTORY_FINE_BUCKETS> _historyFine {HISTORY_FINE_MINUTES};
+        #endif
+        #if HISTORY_COARSE_BUCKETS > 0
+        HvacHistoryLevel<HISTORY_COARSE_BUCKETS> _historyCoarse {HISTORY_COARSE_MINUTES};
+        #endif
+        uint32_t _lastHistorySample = 0;
+
+        // debug log
+        #if defined(HVAC_DEBUG)
+        hvacLogRecord _log[LOG_BUFFER_SIZE];
+        uint8_t _logHead = 0;
+        uint8_t _logCount = 0;
+        uint16_t _logDropped = 0;
+        uint8_t _logLevel = HVAC_LOG_DEBUG;
+        void writeLog(uint8_t event, int16_t arg1 = 0, int16_t arg2 = 0, int16_t arg3 = 0);
+        #endif
+
+        // notification
+        uint32_t _lastSettingsCallback = 0;
+        uint32_t _lastStatusCallback = 0;
+        uint32_t _lastUpdateCallback = 0;
+        uint8_t _settingsCallbackBucket = 0;
+        uint8_t _statusCallbackBucket = 0;
+        uint8_t _updateCallbackBucket = 0;
 
         // handshake SYN packet
-        const byte HANDSHAKE_SYN_PACKET_1[8]  = {2, 255, 255, 0, 0, 0, 0, 2};
-        const byte HANDSHAKE_SYN_PACKET_2[9]  = {2, 255, 255, 1, 0, 0, 1, 2, 254};
-        const byte HANDSHAKE_SYN_PACKET_3[10] = {2, 0, 0, 0, 0, 0, 2, 2, 2, 250};
-        const byte HANDSHAKE_SYN_PACKET_4[10] = {2, 0, 1, 129, 1, 0, 2, 0, 0, 123};
-        const byte HANDSHAKE_SYN_PACKET_5[10] = {2, 0, 1, 2, 0, 0, 2, 0, 0, 254};
-        const byte HANDSHAKE_SYN_PACKET_6[8]  = {2, 0, 2, 0, 0, 0, 0, 254};
+        static constexpr byte HANDSHAKE_SYN_PACKET_1[8] HVAC_PROGMEM  = {2, 255, 255, 0, 0, 0, 0, 2};
+        static constexpr byte HANDSHAKE_SYN_PACKET_2[9] HVAC_PROGMEM  = {2, 255, 255, 1, 0, 0, 1, 2, 254};
+        static constexpr byte HANDSHAKE_SYN_PACKET_3[10] HVAC_PROGMEM = {2, 0, 0, 0, 0, 0, 2, 2, 2, 250};
+        static constexpr byte HANDSHAKE_SYN_PACKET_4[10] HVAC_PROGMEM = {2, 0, 1, 129, 1, 0, 2, 0, 0, 123};
+        static constexpr byte HANDSHAKE_SYN_PACKET_5[10] HVAC_PROGMEM = {2, 0, 1, 2, 0, 0, 2, 0, 0, 254};
+        static constexpr byte HANDSHAKE_SYN_PACKET_6[8] HVAC_PROGMEM  = {2, 0, 2, 0, 0, 0, 0, 254};
 
         // handshake ACK packet
-        const byte HANDSHAKE_ACK_PACKET_1[10] = {2, 0, 2, 1, 0, 0, 2, 0, 0, 251};
-        const byte HANDSHAKE_ACK_PACKET_2[10] = {2, 0, 2, 2, 0, 0, 2, 0, 0, 250};
+        static constexpr byte HANDSHAKE_ACK_PACKET_1[10] HVAC_PROGMEM = {2, 0, 2, 1, 0, 0, 2, 0, 0, 251};
+        static constexpr byte HANDSHAKE_ACK_PACKET_2[10] HVAC_PROGMEM = {2, 0, 2, 2, 0, 0, 2, 0, 0, 250};
+
+        // query packet of every function, built at compile time
+        static constexpr byte QUERY_PACKET[15][14] HVAC_PROGMEM = {HVAC_QUERY_PACKET(128), HVAC_QUERY_PACKET(135), HVAC_QUERY_PACKET(144), HVAC_QUERY_PACKET(148), HVAC_QUERY_PACKET(160),
+                                                                  HVAC_QUERY_PACKET(163), HVAC_QUERY_PACKET(176), HVAC_QUERY_PACKET(179), HVAC_QUERY_PACKET(187), HVAC_QUERY_PACKET(190),
+                                                                  HVAC_QUERY_PACKET(199), HVAC_QUERY_PACKET(222), HVAC_QUERY_PACKET(223), HVAC_QUERY_PACKET(247), HVAC_QUERY_PACKET(248)};
+
+        static_assert(hvacChecksumValid(HANDSHAKE_SYN_PACKET_1, 8), "HANDSHAKE_SYN_PACKET_1 checksum");
+        static_assert(hvacChecksumValid(HANDSHAKE_SYN_PACKET_2, 9), "HANDSHAKE_SYN_PACKET_2 checksum");
+        static_assert(hvacChecksumValid(HANDSHAKE_SYN_PACKET_3, 10), "HANDSHAKE_SYN_PACKET_3 checksum");
+        static_assert(hvacChecksumValid(HANDSHAKE_SYN_PACKET_4, 10), "HANDSHAKE_SYN_PACKET_4 checksum");
+        // HANDSHAKE_SYN_PACKET_5 is sent as captured, its last byte doesn't match the checksum
+        static_assert(hvacChecksumValid(HANDSHAKE_SYN_PACKET_6, 8), "HANDSHAKE_SYN_PACKET_6 checksum");
+        static_assert(hvacChecksumValid(HANDSHAKE_ACK_PACKET_1, 10), "HANDSHAKE_ACK_PACKET_1 checksum");
+        static_assert(hvacChecksumValid(HANDSHAKE_ACK_PACKET_2, 10), "HANDSHAKE_ACK_PACKET_2 checksum");
+        static_assert(hvacQueryPacketsValid(QUERY_PACKET, 15), "QUERY_PACKET checksum or length");
 
         // packet config and type map
         const byte HANDSHAKE_HEADER[3] = {2, 0, 0};
@@ -125,6 +540,17 @@ class ToshibaCarrierHvac {
         const byte PACKET_TYPE[5]      = {16, 17, 128, 130, 144};
         const char* PACKET_TYPE_MAP[6] = {"COMMAND", "FEEDBACK", "SYN/ACK", "ACK", "REPLY", "UNKNOWN"};
 
+        // bootstrap plan, groups first then single functions, functions already received (group reply or feedback) are skipped.
+        // functions carried by group 1 are last so they are only queried when the unit doesn't answer the group query
+        const byte QUERYALL_FUNCTION[15] = {248, 128, 135, 144, 148, 163, 187, 190, 199, 222, 223, 176, 179, 160, 247};
+        const byte FN_GROUP_1_FUNCTION[4] = {176, 179, 160, 247};   // mode, setpoint, fan mode, operation
+        const byte PROBE_RISKY_FUNCTION[3] = {199, 222, 223};       // pure, wifi led, rebooted older models when queried
+
+        const byte FIELD_FUNCTION[13] = {128, 179, 176, 163, 160, 199, 135, 247, 222, 187, 190, 148, 144};
+        const char* FIELD_MAP[15] = {"STATE", "SETPOINT", "MODE", "SWING", "FANMODE", "PURE", "PSEL", "OP", "WIFILED", "ROOMTEMP", "OUTSIDETEMP", "OFFTIMER", "ONTIMER", "CDU_STATE", "UNKNOWN"};
+        const char* hvacSettings::* const SETTINGS_MEMBER[9] = {&hvacSettings::state, nullptr, &hvacSettings::mode, &hvacSettings::swing, &hvacSettings::fanMode,
+                                                                &hvacSettings::pure, &hvacSettings::powerSelect, &hvacSettings::operation, &hvacSettings::wifiLed};
+
         const byte FUNCTION_BYTE[16] = {128, 135, 136, 144, 148, 160, 163, 176, 179, 187, 190, 199, 222, 223, 247, 248};
         const char* FUNCTION_BYTE_MAP[17] = {"STATE", "PSEL", "STATUS", "ONTIMER","OFFTIMER", "FANMODE", "SWING", "MODE", "SETPOINT", "ROOMTEMP", "OUTSIDETEMP", "PURE", "WIFILED1", "WIFILED2", "OP", "FN_GROUP_1", "UNKNOWN"};
 
@@ -134,27 +560,40 @@ class ToshibaCarrierHvac {
         const byte FANMODE_BYTE[7] = {49, 50, 51, 52, 53, 54, 65};
         const char* FANMODE_BYTE_MAP[8] = {"quiet", "lvl_1", "lvl_2", "lvl_3", "lvl_4", "lvl_5", "auto", "UNKNOWN"};
 
+        #if HVAC_FEATURES & HVAC_FEATURE_PSEL
         const byte PSEL_BYTE[3] = {50, 75, 100};
         const char* PSEL_BYTE_MAP[4] = {"50%", "75%", "100%", "UNKNOWN"};
+        #endif
 
+        #if HVAC_FEATURES & HVAC_FEATURE_OP
         const byte OP_BYTE[8] = {0, 1, 2, 3, 4, 10, 32, 48};
         const char* OP_BYTE_MAP[9] = {"normal", "high_power", "silent_1", "eco", "eight_deg", "silent_2", "fireplace_1", "fireplace_2", "UNKNOWN"};
+        #endif
 
         const byte STATUS_BYTE[1] = {66};
         const char* STATUS_BYTE_MAP[2] = {"READY", "UNKNOWN"};
 
+        #if HVAC_FEATURES & HVAC_FEATURE_SWING
         const byte SWING_BYTE[9] = {49, 65, 66, 67, 80, 81, 82, 83, 84};
         const char* SWING_BYTE_MAP[10] = {"fix", "v_swing", "h_swing", "hv_swing", "fix_pos_1", "fix_pos_2", "fix_pos_3", "fix_pos_4", "fix_pos_5", "UNKNOWN"};
+        #endif
 
         const byte STATE_BYTE[2] = {49, 48};
+        #if HVAC_FEATURES & HVAC_FEATURE_PURE
         const byte PURE_BYTE[2] = {16, 24};
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_TIMERS
         const byte TIMER_BYTE[2] = {66, 65};
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_WIFILED
         const byte WIFILED1_BYTE[2] = {0, 5};
         const byte WIFILED2_BYTE[2] = {128, 0};
+        #endif
         const char* OFF_ON_MAP[3] = {"off", "on", "UNKNOWN"};
 
-        void sendPacket(byte data[], size_t dataLen);
-        void sendPacket(const byte data[], size_t dataLen);
+        bool sendPacket(const byte data[], size_t dataLen, bool flash = false);
+        bool sendQuery(byte function);
+        void flushTx(void);
         byte getByteByName(const byte byteMap[], const char* valMap[], size_t valLen, const char* name);
         const char* getNameByByte(const char* valMap[], const byte byteMap[], size_t valLen, byte byteVal);
         byte checksum(uint16_t baseKey, byte data[], size_t dataLen);
@@ -162,37 +601,116 @@ class ToshibaCarrierHvac {
         bool createPacket(const byte header[], size_t headerLen, byte packetType, byte data[],byte dataLen);
         void sendHandshake(void);
         void queryall(void);
+        uint16_t getFunctionBit(byte function);
+        void markReceived(byte function);
+        bool isReceived(byte function);
+        void queueQuery(byte function);
+        byte nextQuery(void);
+        void completeQuery(byte function);
+        void pumpQueries(void);
+        bool queueQueries(void);
         void queryTemperature(void);
-        bool syncUserSettings(void);
+        void updatePollInterval(void);
+        void matchCalibrateReply(byte data[], size_t dataLen);
+        bool waitReplies(void);
+        bool probePacing(bool settings, uint16_t gap);
+        bool isSupported(byte function);
+        void checkProbe(void);
+        uint16_t calibrateGap(bool settings, uint16_t from);
+        uint8_t getIndexByName(const char* valMap[], size_t valLen, const char* name);
+        const char* getNameByIndex(const char* valMap[], size_t valLen, uint8_t index);
+        void createCache(hvacCache* cache);
+        bool loadCache(void);
+        void saveCache(void);
+        void revalidate(void);
+        byte getSettingValue(hvacSettings* settings, uint8_t index);
+        uint8_t freeWriteSlot(void);
+        HvacWrite createWrite(hvacSettings* newSettings, uint16_t mask);
+        void finishWrite(uint8_t slot, hvacWriteState state);
+        bool confirmWrites(uint8_t field);
+        bool isWriteWaiting(uint8_t field);
+        void checkWrites(void);
+        uint8_t getFieldByFunction(byte function);
+        const char* getSettingName(uint8_t field, byte value);
+        bool updateSetting(uint8_t field, byte value);
+        int16_t getStatusValue(uint8_t field);
+        bool updateStatus(uint8_t field, int16_t value);
+        void recordChange(uint8_t field, int16_t oldValue, int16_t newValue);
+        void sampleHistory(void);
+        void runSchedule(void);
+        void applySchedule(uint8_t slot);
+        bool loadSchedule(void);
+        bool saveSchedule(void);
+        bool syncUserSettings(uint16_t ready);
+        uint16_t readySettings(void);
+        bool hasCommandToken(void);
+        void takeCommandToken(void);
+        void sendHeartbeat(void);
+        void heartbeatReply(void);
+        uint16_t heartbeatTimeout(void);
         bool processData(byte data[], size_t dataLen);
         bool readPacket(byte data[], size_t dataLen);
-        bool findHeader(byte data[], size_t dataLen, const byte header[], size_t headerLen);
-        uint8_t findHeaderStart(byte data[], size_t dataLen, const byte header[], size_t headerLen);
-        bool chunkSplit(byte data[], size_t dataLen);
+        bool assembleFrames(void);
+        void dropFrameBytes(uint8_t count);
         bool packetMonitor(void);
         void sendDebug(char* message, uint8_t len);
+        void resetConnection(void);
+        uint8_t payloadOffset(const byte frame[], uint8_t frameLen);
+        hvacFrame frameView(const byte frame[], uint8_t frameLen);
+
+    protected:
+        ToshibaCarrierHvacCore(void);
+        virtual size_t readTransport(byte data[], size_t length) = 0;         // read up to length bytes already received, must not wait
+        virtual size_t writeTransport(const byte data[], size_t length) = 0;
+        virtual int writableTransport(void) = 0;                               // bytes transport can take without waiting
+
+        HvacEventCursor _notifyCursor;
+        bool _tapFrames = false;                    // listener has onFrame
+        virtual void tapFrame(hvacFrame frame) {}
+        bool takeNotify(uint8_t* bucket, uint32_t last);
+        uint32_t notifyDeadline(uint32_t next, uint8_t bucket, uint32_t last);    // earlier of next and callback timeout
+        bool takeSettingsNotify(void) { return takeNotify(&_settingsCallbackBucket, _lastSettingsCallback); }
+        bool takeStatusNotify(void) { return takeNotify(&_statusCallbackBucket, _lastStatusCallback); }
+        bool takeUpdateNotify(void) { return takeNotify(&_updateCallbackBucket, _lastUpdateCallback); }
+        uint32_t settingsNotifyDeadline(uint32_t next) { return notifyDeadline(next, _settingsCallbackBucket, _lastSettingsCallback); }
+        uint32_t statusNotifyDeadline(uint32_t next) { return notifyDeadline(next, _statusCallbackBucket, _lastStatusCallback); }
+        uint32_t updateNotifyDeadline(uint32_t next) { return notifyDeadline(next, _updateCallbackBucket, _lastUpdateCallback); }
+        bool takeWriteNotify(HvacWrite* write);
+        bool takeLinkNotify(bool* up);
+        bool linkNotifyPending(void) { return _linkUp != _connected; }
+        const char* getFunctionName(uint8_t field);
+        bool overBudget(uint8_t deferred);  // time budget used up, deferred work is reported by getPendingWork()
+        // protocol only, without listener notify, public versions are in ToshibaCarrierHvacT
+        void handleHvac (uint32_t maxMicros = 0);
+        uint32_t getNextDeadline(void);     // ms until handleHvac has work to do unless data is received, 0 = call again now, 0xFFFFFFFF = nothing scheduled
+        #if defined(HVAC_PROFILE)
+        HvacProfiler _profiler;
+        #endif
 
     public:
-        ToshibaCarrierHvac(uint8_t rxPin, uint8_t txPin);
-        ToshibaCarrierHvac(HardwareSerial* port);
-        ~ToshibaCarrierHvac();
-
-        void setStatusUpdatedCallback(STATUS_UPDATED_CALLBACK_SIGNATURE);
-        void setSettingsUpdatedCallback(SETTINGS_UPDATED_CALLBACK_SIGNATURE);
-        void setUpdateCallback(UPDATE_CALLBACK_SIGNATURE);
-        void setWhichFunctionUpdatedCallback(WHICH_FUNCTION_UPDATED_CALLBACK_SIGNATURE);
-
-        void handleHvac (void);
-        void applyPreset(hvacSettings newSettings);
-        void setState(const char* newState);
-        void setSetpoint(uint8_t newSetpoint);
-        void setMode(const char* newMode);
-        void setSwing(const char* newSwing);
-        void setFanMode(const char* newFanMode);
-        void setPure(const char* newPure);
-        void setPowerSelect(const char* newPowerSelect);
-        void setOperation(const char* newOperation);
-        void setWifiLed(const char* newWifiLed);
+        virtual ~ToshibaCarrierHvacCore() {}
+
+        uint8_t getPendingWork(void);
+        HvacWrite applyPreset(hvacSettings newSettings);
+        HvacWrite setState(const char* newState);
+        HvacWrite setSetpoint(uint8_t newSetpoint);
+        HvacWrite setMode(const char* newMode);
+        #if HVAC_FEATURES & HVAC_FEATURE_SWING
+        HvacWrite setSwing(const char* newSwing);
+        #endif
+        HvacWrite setFanMode(const char* newFanMode);
+        #if HVAC_FEATURES & HVAC_FEATURE_PURE
+        HvacWrite setPure(const char* newPure);
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_PSEL
+        HvacWrite setPowerSelect(const char* newPowerSelect);
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_OP
+        HvacWrite setOperation(const char* newOperation);
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_WIFILED
+        HvacWrite setWifiLed(const char* newWifiLed);
+        #endif
         hvacStatus getStatus(void);
         hvacSettings getSettings(void);
         int8_t getRoomTemperature(void);
@@ -200,18 +718,258 @@ class ToshibaCarrierHvac {
         const char* getState(void);
         uint8_t getSetpoint(void);
         const char* getMode(void);
+        #if HVAC_FEATURES & HVAC_FEATURE_SWING
         const char* getSwing(void);
+        #endif
         const char* getFanMode(void);
+        #if HVAC_FEATURES & HVAC_FEATURE_PURE
         const char* getPure(void);
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_TIMERS
         const char* getOffTimer(void);
         const char* getOnTimer(void);
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_PSEL
         const char* getPowerSelect(void);
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_OP
         const char* getOperation(void);
+        #endif
+        #if HVAC_FEATURES & HVAC_FEATURE_WIFILED
         const char* getWifiLed(void);
+        #endif
         bool isCduRunning(void);
         bool isConnected(void);
         void forceQueryAllData(void);
+        void setPollInterval(uint16_t minInterval, uint16_t maxInterval);
+        uint16_t getPollInterval(void);
+        bool calibratePacing(void);
+        void setPacing(hvacPacing newPacing);
+        hvacPacing getPacing(void);
+        bool probeFunctions(bool risky = false);
+        bool isProbing(void);
+        void setFunctionProfile(uint16_t profile);
+        uint16_t getFunctionProfile(void);
+        bool isFieldSupported(uint8_t field);
+        void setQueryPipeline(uint8_t depth);
+        uint8_t getQueryPipeline(void);
+        void setCoalesceDelay(uint16_t delay);
+        uint16_t getCoalesceDelay(void);
+        void setCommandRate(uint8_t perMinute);
+        void setHeartbeat(uint16_t interval, uint8_t maxMissed = HEARTBEAT_MAX_MISSED);
+        hvacLinkStats getLinkStats(void);
+        void resetLinkStats(void);
+        uint8_t getCommandRate(void);
+        hvacWriteStats getWriteStats(void);
+        void resetWriteStats(void);
+        bool setStorage(HvacStorage* storage, uint16_t address = 0);
+        bool isRevalidated(void);
+        void setClock(HvacClock* clock);
+        int8_t addSchedule(uint8_t days, uint8_t hour, uint8_t minute, hvacSettings preset);
+        bool getSchedule(uint8_t slot, uint8_t* days, uint8_t* hour, uint8_t* minute, hvacSettings* preset);
+        bool removeSchedule(uint8_t slot);
+        void clearSchedule(void);
+        uint32_t getNextSchedule(void);
+        HvacEventCursor getEventCursor(bool fromOldest = false);
+        bool readEvent(HvacEventCursor* cursor, hvacEvent* event);
+        uint32_t getGeneration(void);
+        bool changedSince(uint32_t generation);
+        const char* getFieldName(uint8_t field);
+        const char* getValueName(uint8_t field, int16_t value);
+        uint16_t getHistoryLength(hvacHistoryResolution resolution);
+        uint16_t getHistoryMinutes(hvacHistoryResolution resolution);
+        bool getHistory(hvacHistoryResolution resolution, uint16_t age, hvacHistoryBucket* bucket);
+        uint16_t exportHistory(Print* out, hvacHistoryResolution resolution, uint16_t maxBuckets = 0xFFFF);
+        void setLogLevel(hvacLogLevel level);
+        hvacLogLevel getLogLevel(void);
+        bool readLog(hvacLogRecord* record);
+        uint16_t printLog(Print* out);
+        uint16_t dumpLog(Print* out);
+        uint16_t getLogDropped(void);
+        bool getProfile(hvacProfileStage stage, hvacProfileStats* stats);
+        void resetProfile(void);
+        void printProfile(Print* out);
+        void setListenOnly(bool listenOnly);
+        bool isListenOnly(void);
 
         bool sendCustomPacket(byte data[], size_t length);
 };
+
+// listener base with empty handlers, derive and hide only handlers you need. Handlers not declared in your listener cost nothing
+class HvacListener {
+    public:
+        void onSettings(hvacSettings newSettings) {}                // settings updated (debounced)
+        void onStatus(hvacStatus newStatus) {}                      // status updated (debounced)
+        void onUpdate(void) {}                                      // settings or status updated (debounced)
+        void onField(hvacEvent event, const char* function) {}     // every change, function is name of updated function
+        void onWrite(HvacWrite write) {}                            // write confirmed or failed
+        void onFrame(hvacFrame frame) {}                            // every received frame before it is decoded, also unknown functions
+        void onLink(bool connected) {}                              // connected or link lost
+};
+
+template<class T, class U> struct hvacIsSame { enum { value = 0 }; };
+template<class T> struct hvacIsSame<T, T> { enum { value = 1 }; };
+#define HVAC_LISTENER_HAS(handler) (!hvacIsSame<decltype(&Listener::handler), decltype(&HvacListener::handler)>::value)
+
+// open hvac port at 9600 8E1, other transports must be opened by you before
+template<class Transport> inline void hvacBeginTransport(Transport* port) {}
+void hvacBeginTransport(HardwareSerial* port);
+#if defined(HVAC_USE_SW_SERIAL)
+void hvacBeginTransport(HvacSoftwareSerial* port);
+#endif
+
+// bytes transport can take without waiting
+template<class Transport> inline int hvacAvailableForWrite(Transport* port) { return port->availableForWrite(); }
+#if defined(HVAC_USE_SW_SERIAL)
+inline int hvacAvailableForWrite(HvacSoftwareSerial* port) { return TX_BUFFER_SIZE; }  // no TX buffer, write returns when sent
+#endif
+
+// notification and transport resolved at compile time, Listener must derive from HvacListener
+// Transport can be HardwareSerial, HvacSoftwareSerial, HvacPipeTransport, HvacFdTransport or any class with available(), readBytes(), write() and availableForWrite()
+template<class Listener, class Transport = Stream>
+class ToshibaCarrierHvacT : public ToshibaCarrierHvacCore {
+    protected:
+        Listener _listener;
+        Transport* _port;
+
+        size_t readTransport(byte data[], size_t length) {
+            int count = _port->available();
+            if (count <= 0) return 0;
+            if ((size_t)count < length) length = count;
+            return _port->readBytes(data, length);
+        }
+
+        size_t writeTransport(const byte data[], size_t length) {
+            return _port->write(data, length);
+        }
+
+        int writableTransport(void) {
+            return hvacAvailableForWrite(_port);
+        }
+
+        void tapFrame(hvacFrame frame) {
+            _listener.onFrame(frame);
+        }
+
+    public:
+        ToshibaCarrierHvacT(Transport* port) : _port(port) {
+            _tapFrames = HVAC_LISTENER_HAS(onFrame);
+            hvacBeginTransport(port);
+        }
+
+        Listener& listener(void) { return _listener; }
+        Transport* transport(void) { return _port; }
+
+        // maxMicros > 0 stops at next safe point when used up (at least one packet and one callback per call), rest is done on next call
+        void handleHvac(uint32_t maxMicros = 0) {
+            HVAC_PROFILE_CALL();
+            ToshibaCarrierHvacCore::handleHvac(maxMicros);
+            HVAC_PROFILE_SCOPE(PROFILE_CALLBACK);
+            if (HVAC_LISTENER_HAS(onWrite)) {
+                HvacWrite write;
+                while (takeWriteNotify(&write)) {
+                    _listener.onWrite(write);
+                    if (overBudget(PENDING_NOTIFY)) return;
+                }
+            }
+            if (HVAC_LISTENER_HAS(onField)) {
+                hvacEvent event;
+                while (readEvent(&_notifyCursor, &event)) {
+                    _listener.onField(event, getFunctionName(event.field));
+                    if (overBudget(PENDING_NOTIFY)) return;
+                }
+            }
+            if (HVAC_LISTENER_HAS(onSettings) && takeSettingsNotify()) {
+                _listener.onSettings(getSettings());
+                if (overBudget(PENDING_NOTIFY)) return;
+            }
+            if (HVAC_LISTENER_HAS(onStatus) && takeStatusNotify()) {
+                _listener.onStatus(getStatus());
+                if (overBudget(PENDING_NOTIFY)) return;
+            }
+            if (HVAC_LISTENER_HAS(onUpdate) && takeUpdateNotify()) _listener.onUpdate();
+            if (HVAC_LISTENER_HAS(onLink)) {
+                bool up;
+                if (takeLinkNotify(&up)) _listener.onLink(up);
+            }
+        }
+
+        // callbacks count only when listener has them, buckets of missing callbacks are never taken
+        uint32_t getNextDeadline(void) {
+            uint32_t next = ToshibaCarrierHvacCore::getNextDeadline();
+            if (HVAC_LISTENER_HAS(onSettings)) next = settingsNotifyDeadline(next);
+            if (HVAC_LISTENER_HAS(onStatus)) next = statusNotifyDeadline(next);
+            if (HVAC_LISTENER_HAS(onUpdate)) next = updateNotifyDeadline(next);
+            if (HVAC_LISTENER_HAS(onLink) && linkNotifyPending()) next = 0;
+            return next;
+        }
+};
+
+// listener calling runtime callbacks
+class HvacCallbackListener : public HvacListener {
+    public:
+        STATUS_UPDATED_CALLBACK_SIGNATURE {nullptr};
+        SETTINGS_UPDATED_CALLBACK_SIGNATURE {nullptr};
+        UPDATE_CALLBACK_SIGNATURE {nullptr};
+        WHICH_FUNCTION_UPDATED_CALLBACK_SIGNATURE {nullptr};
+        WRITE_COMPLETED_CALLBACK_SIGNATURE {nullptr};
+        FRAME_RECEIVED_CALLBACK_SIGNATURE {nullptr};
+        LINK_CHANGED_CALLBACK_SIGNATURE {nullptr};
+
+        void onSettings(hvacSettings newSettings) { if (settingsUpdatedCallback) settingsUpdatedCallback(newSettings); }
+        void onStatus(hvacStatus newStatus) { if (statusUpdatedCallback) statusUpdatedCallback(newStatus); }
+        void onUpdate(void) { if (updateCallback) updateCallback(); }
+        void onField(hvacEvent event, const char* function) { if (whichFunctionUpdatedCallback) whichFunctionUpdatedCallback(function); }
+        void onWrite(HvacWrite write) { if (writeCompletedCallback) writeCompletedCallback(write); }
+        void onFrame(hvacFrame frame) { if (frameReceivedCallback) frameReceivedCallback(frame); }
+        void onLink(bool connected) { if (linkChangedCallback) linkChangedCallback(connected); }
+};
+
+class ToshibaCarrierHvac : public ToshibaCarrierHvacT<HvacCallbackListener> {
+    private:
+        #if defined(HVAC_USE_SW_SERIAL)
+        HvacSoftwareSerial* _swSerial;
+        #endif
+
+    protected:
+        int writableTransport(void) {
+            #if defined(HVAC_USE_SW_SERIAL)
+            if (_swSerial) return hvacAvailableForWrite(_swSerial);
+            #endif
+            return ToshibaCarrierHvacT<HvacCallbackListener>::writableTransport();
+        }
+
+    public:
+        ToshibaCarrierHvac(HardwareSerial* port) : ToshibaCarrierHvacT<HvacCallbackListener>(port)
+        #if defined(HVAC_USE_SW_SERIAL)
+        , _swSerial(nullptr)
+        #endif
+        {
+            _tapFrames = false;     // until frame callback is set
+            hvacBeginTransport(port);
+        }
+
+        #if defined(HVAC_USE_SW_SERIAL)
+        ToshibaCarrierHvac(uint8_t rxPin, uint8_t txPin) : ToshibaCarrierHvacT<HvacCallbackListener>(new HvacSoftwareSerial(rxPin, txPin)),
+            _swSerial(static_cast<HvacSoftwareSerial*>(_port)) {
+            _tapFrames = false;
+            hvacBeginTransport(_swSerial);
+        }
+
+        ~ToshibaCarrierHvac() {
+            delete _swSerial;
+        }
+        #endif
+
+        void setStatusUpdatedCallback(STATUS_UPDATED_CALLBACK_SIGNATURE) { _listener.statusUpdatedCallback = statusUpdatedCallback; }
+        void setSettingsUpdatedCallback(SETTINGS_UPDATED_CALLBACK_SIGNATURE) { _listener.settingsUpdatedCallback = settingsUpdatedCallback; }
+        void setUpdateCallback(UPDATE_CALLBACK_SIGNATURE) { _listener.updateCallback = updateCallback; }
+        void setWhichFunctionUpdatedCallback(WHICH_FUNCTION_UPDATED_CALLBACK_SIGNATURE) { _listener.whichFunctionUpdatedCallback = whichFunctionUpdatedCallback; }
+        void setWriteCompletedCallback(WRITE_COMPLETED_CALLBACK_SIGNATURE) { _listener.writeCompletedCallback = writeCompletedCallback; }
+        void setLinkChangedCallback(LINK_CHANGED_CALLBACK_SIGNATURE) { _listener.linkChangedCallback = linkChangedCallback; }
+        void setFrameReceivedCallback(FRAME_RECEIVED_CALLBACK_SIGNATURE) {
+            _listener.frameReceivedCallback = frameReceivedCallback;
+            _tapFrames = (frameReceivedCallback != nullptr);
+        }
+};
 #endif // ToshibaCarrierHvac_H
\ No newline at end of file